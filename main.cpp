@@ -1,15 +1,28 @@
 #include "src/AudioConfig.hpp"
+#include "src/BatchRunner.hpp"
 #include "src/CommandLine.hpp"
+#include "src/FlightRecorder.hpp"
+#include "src/HeadlessControl.hpp"
 #include "src/InputHook.hpp"
+#include "src/JsonLine.hpp"
 #include "src/Logger.hpp"
+#include "src/Metrics.hpp"
 #include "src/Paster.hpp"
 #include "src/Recorder.hpp"
+#include "src/Spectrogram.hpp"
 #include "src/StatusWindow.hpp"
+#include "src/StreamCommitter.hpp"
+#include "src/Trace.hpp"
 #include "src/Transcriber.hpp"
+#include "src/UiRenderer.hpp"
+#include "src/WakeWordListener.hpp"
+#include "src/X11Connection.hpp"
+#include <atomic>
 #include <chrono>
 #include <exception>
 #include <format>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <cstdio>
@@ -32,6 +45,7 @@ static char g_crash_report_filename[256] = "\0"; // Initialize to empty string
 
 // Asynchronous-safe crash handler
 void crash_handler(int sig) {
+    Logger::instance().drainOnCrash(); // Lines still queued for voicecli.log
     fflush(stderr); // Flush buffered stderr before async-safe dprintf
 
     dprintf(STDERR_FILENO, "\n!!! CRITICAL ERROR: VoiceCLI has crashed with signal %d !!!\n", sig);
@@ -43,7 +57,9 @@ void crash_handler(int sig) {
             // Version is written here ONLY. Removed from main startup.
             dprintf(fileno(crash_report_file), "VoiceCLI Version: %s\n", APP_VERSION); 
             dprintf(fileno(crash_report_file), "\n!!! CRITICAL ERROR: VoiceCLI has crashed with signal %d !!!\n", sig);
-            dprintf(fileno(crash_report_file), "Stack trace:\n");
+            dprintf(fileno(crash_report_file), "\n");
+            FlightRecorder::dump(fileno(crash_report_file)); // Before the backtrace, which may fault again
+            dprintf(fileno(crash_report_file), "\nStack trace:\n");
 
             backward::StackTrace st;
             st.load_here(32);
@@ -97,6 +113,7 @@ std::string trim(const std::string& s) {
  */
 std::string runPostProcess(const std::string& cmd, const std::string& input) {
     if (cmd.empty()) return input;
+    TRACE_SCOPE("runPostProcess");
 
     // Write input to temp file
     std::string tempIn = "/tmp/voicecli_pp_in.txt";
@@ -170,14 +187,290 @@ std::optional<AudioDevice> getSelectedDevice(AudioConfig& audio, std::optional<u
  * @return The focused Window ID, or 0 on failure.
  */
 Window getCurrentFocus() {
-  Display* d = XOpenDisplay(NULL);
-  if (!d) return 0;
-
-  Window focus;
-  int revert;
-  XGetInputFocus(d, &focus, &revert);
-  XCloseDisplay(d);
-  return focus;
+  try {
+    return X11Connection::instance().focusedWindow();
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+/**
+ * @brief Decodes a command with the phrase grammar and logs the outcome.
+ *
+ * @param transcriber The loaded transcriber.
+ * @param pcm16k 16kHz mono samples of the utterance.
+ * @param commands The compiled phrase list.
+ * @param config The application configuration (threshold, logging policy).
+ * @return The match; match.matched is cleared if the score is below the threshold.
+ */
+CommandMatch recognizeCommand(Transcriber& transcriber, const std::vector<float>& pcm16k,
+                              const CommandGrammar& commands, const AppConfig& config) {
+  auto start = std::chrono::steady_clock::now();
+  CommandMatch match = transcriber.transcribeCommand(pcm16k, commands);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+  if (config.logTranscriptions) {
+    Logger::instance().log(std::format("Command: heard '{}' -> '{}' (score {:.2f}, {} ms)",
+                                       match.heard, match.id, match.score, ms.count()));
+  } else {
+    Logger::instance().log(std::format("Command: decoded with score {:.2f} in {} ms.", match.score, ms.count()));
+  }
+  if (match.score < config.commandThreshold) match.matched = false;
+  return match;
+}
+
+/**
+ * @brief Removes the pre-opened crash report file after a clean shutdown.
+ */
+void cleanupCrashReport() {
+  if (g_crash_report_fd != -1) {
+      close(g_crash_report_fd); // Close the file descriptor
+      g_crash_report_fd = -1;
+      // If the application exits normally, we should clean up the temporary file.
+      std::error_code ec;
+      std::filesystem::remove(g_crash_report_filename, ec);
+      if (ec) {
+          Logger::instance().error("Failed to remove temporary crash report file: " + std::string(g_crash_report_filename) + " Error: " + ec.message());
+      }
+  }
+}
+
+/**
+ * @brief Runs VoiceCLI as a pure transcription engine without any X11 connection.
+ *
+ * Sessions are driven by line commands (start, stop, pause, resume, extend, abort,
+ * status, exit) read from stdin or from a Unix socket client. Every state change is
+ * written back as a JSON line, e.g. {"event":"transcription","text":"..."}.
+ *
+ * @param config The parsed application configuration.
+ * @param audio The audio context used to resolve the capture device.
+ * @param device The capture device to record from.
+ * @return The process exit code.
+ */
+int runHeadless(const AppConfig& config, AudioConfig& audio, const AudioDevice& device) {
+  std::signal(SIGPIPE, SIG_IGN); // A vanished controller must not kill the engine
+
+  std::unique_ptr<HeadlessControl> control;
+  try {
+    control = std::make_unique<HeadlessControl>(config.controlSocket);
+  } catch (const std::exception& e) {
+    Logger::instance().error(std::format("Headless: {}", e.what()));
+    return 1;
+  }
+
+  auto emitEvent = [&](const std::string& event) {
+    control->emit(JsonLine().addString("event", event).toString());
+  };
+  auto emitError = [&](const std::string& message) {
+    control->emit(JsonLine().addString("event", "error").addString("message", message).toString());
+  };
+
+  Logger::instance().log("Headless: Loading model: " + config.modelPath);
+  std::unique_ptr<Transcriber> transcriber;
+  try {
+    transcriber = std::make_unique<Transcriber>(config.modelPath);
+  } catch (const std::exception& e) {
+    Logger::instance().error(std::format("Headless: {}", e.what()));
+    emitError(e.what());
+    return 1;
+  }
+  std::unique_ptr<CommandGrammar> commands;
+  if (!config.commandsFile.empty()) {
+    try {
+      commands = std::make_unique<CommandGrammar>(config.commandsFile);
+    } catch (const std::exception& e) {
+      Logger::instance().error(std::format("Headless: {}", e.what()));
+      emitError(e.what());
+      return 1;
+    }
+  }
+
+  control->emit(JsonLine().addString("event", "ready").addString("model", config.modelPath)
+                    .addString("device", device.name).toString());
+
+  const std::string tempFile = "/tmp/voicecli_headless.wav";
+  std::unique_ptr<Recorder> rec;
+  std::vector<float> sessionPcm;
+  bool isPaused = false;
+  bool isAutoPaused = false;
+  bool isTimeout = false;
+  auto maxDuration = std::chrono::steady_clock::duration(std::chrono::minutes(config.maxRecordTime));
+  std::chrono::steady_clock::duration activeTime{};
+  auto lastTick = std::chrono::steady_clock::now();
+  auto lastSpeechTime = lastTick;
+
+  auto statusEvent = [&]() {
+    std::string state = !rec ? "idle" : isTimeout ? "timeout" : isPaused ? "paused"
+        : isAutoPaused ? "auto_paused" : "recording";
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(maxDuration - activeTime);
+    return JsonLine().addString("event", "status").addString("state", state)
+        .addNumber("remaining_sec", std::max<int64_t>(0, remaining.count()) / 1000.0, 1).toString();
+  };
+
+  bool shouldExit = false;
+  while (!shouldExit && control->isOpen()) {
+    std::string command;
+    bool haveCommand = control->readCommand(command, 100);
+    auto now = std::chrono::steady_clock::now();
+
+    // Advance the session clock and run the same VAD / time-limit logic as the daemon
+    if (rec) {
+      rec->drain(sessionPcm);
+      if (!isPaused && !isAutoPaused) activeTime += now - lastTick;
+
+      if (rec->getCurrentLevel() > config.vadThreshold) {
+        lastSpeechTime = now;
+        if (isAutoPaused) {
+          isAutoPaused = false;
+          rec->setWriting(true);
+          TRACE_INSTANT("vad.resume");
+          FlightRecorder::record("vad.resume");
+          emitEvent("resumed");
+        }
+      }
+      if (!isPaused && !isAutoPaused &&
+          now - lastSpeechTime > std::chrono::milliseconds(config.vadTimeoutMs)) {
+        isAutoPaused = true;
+        rec->setWriting(false);
+        TRACE_INSTANT("vad.pause");
+        FlightRecorder::record("vad.pause");
+        Metrics::instance().add(Metrics::Counter::VadPauses);
+        emitEvent("auto_paused");
+      }
+      if (!isTimeout && activeTime >= maxDuration) {
+        rec->pause();
+        isTimeout = true;
+        isPaused = true;
+        FlightRecorder::record("session.timeout");
+        Logger::instance().log("Headless: Recording time limit reached.");
+        emitEvent("timeout");
+      }
+    }
+    lastTick = now;
+
+    if (!haveCommand || command.empty()) continue;
+    Logger::instance().log("Headless: Command: " + command);
+
+    if (command == "start") {
+      if (rec) {
+        emitError("session already active");
+        continue;
+      }
+      rec = std::make_unique<Recorder>(audio.getCaptureDeviceID(device.index), config.sampleRate);
+      try {
+        rec->start(tempFile);
+      } catch (const std::exception& e) {
+        Logger::instance().error(std::format("Failed to start recorder: {}", e.what()));
+        emitError(e.what());
+        rec.reset();
+        continue;
+      }
+      sessionPcm.clear();
+      isPaused = false;
+      isAutoPaused = false;
+      isTimeout = false;
+      maxDuration = std::chrono::minutes(config.maxRecordTime);
+      activeTime = {};
+      lastSpeechTime = now;
+      Metrics::instance().add(Metrics::Counter::Sessions);
+      Metrics::instance().observe(Metrics::Histogram::TriggerToRecord, std::chrono::steady_clock::now() - now);
+      FlightRecorder::record("session.start", "headless", 1);
+      emitEvent("recording");
+    } else if (command == "pause" || command == "resume") {
+      if (!rec || isTimeout) {
+        emitError(std::format("cannot {} now", command));
+      } else if (command == "pause" && !isPaused) {
+        isPaused = true;
+        isAutoPaused = false;
+        rec->pause();
+        emitEvent("paused");
+      } else if (command == "resume" && isPaused) {
+        isPaused = false;
+        rec->resume();
+        rec->setWriting(true);
+        lastSpeechTime = now;
+        emitEvent("resumed");
+      }
+    } else if (command == "extend") {
+      maxDuration += std::chrono::minutes(config.maxRecordTime);
+      if (rec && isTimeout) {
+        isTimeout = false;
+        isPaused = false;
+        rec->resume();
+        lastSpeechTime = now;
+        emitEvent("resumed");
+      }
+      control->emit(statusEvent());
+    } else if (command == "stop") {
+      if (!rec) {
+        emitError("no active session");
+        continue;
+      }
+      rec->stop();
+      rec->drain(sessionPcm);
+      bool overran = rec->getOverrunFrames() > 0;
+      Metrics::instance().add(Metrics::Counter::OverrunFrames, rec->getOverrunFrames());
+      FlightRecorder::record("session.stop", "frames", (int64_t)sessionPcm.size(), "rate", rec->getSampleRate());
+      unsigned int rate = rec->getSampleRate();
+      rec.reset();
+      emitEvent("transcribing");
+
+      auto inferStart = std::chrono::steady_clock::now();
+      try {
+        std::vector<float> pcm16k = overran ? Transcriber::loadAudio(tempFile)
+                                            : Transcriber::resampleTo16k(sessionPcm, rate);
+        if (commands) {
+          CommandMatch match = recognizeCommand(*transcriber, pcm16k, *commands, config);
+          auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - inferStart);
+          control->emit(JsonLine().addString("event", "command").addBool("matched", match.matched)
+                            .addString("id", match.matched ? match.id : "")
+                            .addNumber("score", match.score)
+                            .addString("heard", trim(match.heard))
+                            .addInt("latency_ms", latency.count()).toString());
+          continue;
+        }
+
+        std::string text = trim(transcriber->transcribe(pcm16k));
+        if (!config.postProcessCommand.empty()) {
+          text = runPostProcess(config.postProcessCommand, text);
+        }
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - inferStart);
+        Metrics::instance().observe(Metrics::Histogram::StopToText, std::chrono::steady_clock::now() - now);
+        FlightRecorder::record("session.text", "ms", latency.count(), "bytes", (int64_t)text.size());
+        if (config.logTranscriptions) {
+          Logger::instance().log("Transcribed: " + text);
+        }
+        control->emit(JsonLine().addString("event", "transcription").addString("text", text)
+                          .addInt("latency_ms", latency.count()).toString());
+      } catch (const std::exception& e) {
+        FlightRecorder::record("session.error");
+        Logger::instance().error(std::format("Transcription error: {}", e.what()));
+        emitError(e.what());
+      }
+    } else if (command == "abort") {
+      if (rec) {
+        rec->stop();
+        rec.reset();
+        Metrics::instance().add(Metrics::Counter::Aborts);
+        FlightRecorder::record("session.abort");
+        Logger::instance().log("Headless: Recording aborted.");
+      }
+      emitEvent("aborted");
+    } else if (command == "status") {
+      control->emit(statusEvent());
+    } else if (command == "exit" || command == "quit") {
+      shouldExit = true;
+    } else {
+      emitError("unknown command: " + command);
+    }
+  }
+
+  if (rec) rec->stop();
+  emitEvent("exit");
+  Logger::instance().log("Headless: Shutting down.");
+  return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -201,9 +494,26 @@ int main(int argc, char* argv[]) {
   std::signal(SIGBUS,  crash_handler);
   std::signal(SIGTERM, crash_handler);
 
-  // Initialize Logger
+  // Removed try-catch from main, crash_handler will handle exceptions
+  CommandLine cmd(argc, argv);
+  const auto& config = cmd.getConfig();
+
+  if (config.showHelp) {
+    cmd.printHelp();
+    return 0;
+  }
+
+  if (config.showVersion) {
+    std::cout << "VoiceCLI Version: " << APP_VERSION << std::endl;
+    return 0;
+  }
+
+  // Initialize Logger; the rotation limits come first, since opening the log
+  // retires the previous run's file if it is already past them
   std::string homeDir = getenv("HOME");
   std::string logPath = homeDir + "/.VoiceCLI/voicecli.log";
+  Logger::instance().setRotation((uint64_t)config.logMaxSizeMb << 20, std::chrono::hours(config.logMaxAgeHours),
+                                 config.logKeep);
   Logger::instance().setLogFile(logPath);
   Logger::instance().log("Application Started");
 
@@ -214,18 +524,24 @@ int main(int argc, char* argv[]) {
   }
   Logger::instance().log("Command Line: " + cmdLine);
 
-  // Removed try-catch from main, crash_handler will handle exceptions
-  CommandLine cmd(argc, argv);
-  const auto& config = cmd.getConfig();
-
-  if (config.showHelp) {
-    cmd.printHelp();
-    return 0;
+  Logger::FlushPolicy flushPolicy = Logger::FlushPolicy::Batch;
+  Logger::parseFlushPolicy(config.logFlush, flushPolicy);
+  Logger::instance().setFlushPolicy(flushPolicy);
+  if (!config.traceFile.empty()) {
+    Trace::instance().start(config.traceFile);
+  }
+  if (!config.metricsEndpoint.empty()) {
+    try {
+      Metrics::instance().serve(config.metricsEndpoint);
+    } catch (const std::exception& e) {
+      Logger::instance().error(std::format("Metrics: {}", e.what()));
+    }
   }
 
-  if (config.showVersion) {
-    std::cout << "VoiceCLI Version: " << APP_VERSION << std::endl;
-    return 0;
+  // In headless stdio and batch modes stdout carries JSON lines, so route all
+  // human-readable console output to stderr instead.
+  if ((config.headless && config.controlSocket.empty()) || !config.batchPattern.empty()) {
+    std::cout.rdbuf(std::cerr.rdbuf());
   }
 
   AudioConfig audio;
@@ -263,6 +579,21 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  // --- Offline Batch Mode (no microphone, no X11) ---
+  if (!config.batchPattern.empty()) {
+    auto files = BatchRunner::collectFiles(config.batchPattern);
+    if (files.empty()) {
+      Logger::instance().error("Batch: No audio files match " + config.batchPattern);
+      return 1;
+    }
+    Logger::instance().log("Batch: Loading shared model weights: " + modelPath);
+    Transcriber transcriber(modelPath, false);
+    BatchRunner batch(transcriber, config.batchJobs);
+    int failed = batch.run(files, stdout);
+    cleanupCrashReport();
+    return failed == 0 ? 0 : 1;
+  }
+
   // Determine which device we WILL use
   auto selectedDevice = getSelectedDevice(audio, config.deviceIndex);
 
@@ -356,49 +687,139 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  // --- Headless Engine Mode (no X11) ---
+  if (config.headless) {
+    int rc = runHeadless(config, audio, *selectedDevice);
+    cleanupCrashReport();
+    return rc;
+  }
+
   // Default behavior (No args): Run the Daemon
   if (config.verbose) {
     std::cout << "VoiceCLI Daemon starting..." << std::endl;
   }
-  InputHook input;
+  InputHook::Backend inputBackend = InputHook::Backend::Auto;
+  if (config.inputBackend == "xi2") inputBackend = InputHook::Backend::XInput2;
+  if (config.inputBackend == "poll") inputBackend = InputHook::Backend::Polling;
+  InputHook input(inputBackend);
+  Paster paster(homeDir + "/.VoiceCLI/paste_strategies.conf"); // Owns its selection window for the daemon's lifetime
+
+  // Hotkey triggers: explicit bindings and the push-to-talk key, else the double-tap key
+  std::vector<TriggerBinding> triggers;
+  for (const auto& binding : config.triggers) {
+    auto eq = binding.rfind('=');
+    triggers.push_back({ binding.substr(0, eq), binding.substr(eq + 1) });
+  }
+  if (!config.pushToTalkKey.empty()) {
+    triggers.push_back({ config.pushToTalkKey, "push-to-talk" });
+  }
+  if (triggers.empty()) {
+    triggers.push_back({ config.triggerKey + " " + config.triggerKey, "paste" });
+  }
+  try {
+    input.setTriggers(triggers);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    Logger::instance().error(e.what());
+    return 1;
+  }
 
   // Pre-load model to avoid delay on first record
   Logger::instance().log("Loading model: " + modelPath);
   Transcriber transcriber(modelPath);
   Logger::instance().log("Model loaded. Ready.");
 
+  // Optional spoken trigger, confirmed by a small separate model
+  std::unique_ptr<Transcriber> wakeDetector;
+  std::unique_ptr<WakeWordListener> wakeListener;
+  if (!config.wakeWord.empty()) {
+    Logger::instance().log("Loading wake word model: " + config.wakeModel);
+    wakeDetector = std::make_unique<Transcriber>(config.wakeModel);
+    wakeListener = std::make_unique<WakeWordListener>(audio.getCaptureDeviceID(selectedDevice->index),
+        config.sampleRate, config.wakeWord, *wakeDetector, config.vadThreshold);
+    if (config.verbose) {
+      std::cout << "Listening for wake word \"" << config.wakeWord << "\"..." << std::endl;
+    }
+  }
+
+  // Command mode: decoding constrained to a phrase list
+  std::unique_ptr<CommandGrammar> commands;
+  if (!config.commandsFile.empty()) {
+    commands = std::make_unique<CommandGrammar>(config.commandsFile);
+    Logger::instance().log(std::format("Command mode: {} phrases loaded from {}", commands->size(),
+                                       config.commandsFile));
+  }
+
+  // One status window for all sessions, drawn on its own thread
+  std::unique_ptr<Spectrogram> spectrogram;
+  if (config.spectrogram) {
+    spectrogram = std::make_unique<Spectrogram>(config.sampleRate);
+  }
+  UiRenderer ui(config.uiFps, spectrogram.get());
+
   bool shouldExit = false;
   while (!shouldExit) {
-    // 1. Wait for global trigger (Hotkeys)
-    if (!input.monitor(config.triggerKey, config.verbose)) {
-      break; // Stop if monitor fails
+    // 1. Wait for global trigger (Wake word or Hotkeys)
+    std::vector<float> preRoll;
+    std::string action = "paste";
+    int sessionTrigger = -1; // Index of the binding that started the session; -1 for the wake word
+    if (wakeListener) {
+      if (!wakeListener->waitForWake(preRoll)) {
+        break; // Stop if the capture device fails
+      }
+    } else {
+      int fired = input.monitor(config.verbose);
+      if (fired < 0) {
+        break; // Stop if monitor fails
+      }
+      action = triggers[fired].action;
+      sessionTrigger = fired;
     }
+    auto triggerTime = std::chrono::steady_clock::now();
+
+    // Push-to-talk: record while the key is held, transcribe and paste on release
+    const bool pushToTalk = (action == "push-to-talk");
+
+    // Streaming: paste each segment as soon as a pause makes it final (free dictation only)
+    const bool streaming = config.stream && !pushToTalk && !commands;
+    FlightRecorder::record("session.trigger", "pushToTalk", pushToTalk, "streaming", streaming);
 
     // Capture currently focused window before we take over
     Window activeWin = getCurrentFocus();
     Logger::instance().log(std::format("Captured Active Window ID: {}", activeWin));
+    paster.prepare(activeWin); // Resolve its application while the user talks
 
     // 2. Setup Recording Session
-    StatusWindow win;
-    win.show("Starting Recording...");
+    ui.show("Starting Recording...", !pushToTalk && !streaming, triggerTime); // Output goes to activeWin meanwhile
 
     std::string tempFile = "/tmp/voicecli_rec.wav";
     Recorder rec(audio.getCaptureDeviceID(selectedDevice->index), config.sampleRate);
+    rec.setSpectrogram(spectrogram.get());
+    std::vector<float> sessionPcm = preRoll; // In-memory copy of everything written to tempFile
+    auto releaseTime = std::chrono::steady_clock::now();
 
+    // A wake word session continues the listener's stream, so nothing said after the phrase is lost
     try {
-      rec.start(tempFile);
+      rec.start(tempFile, preRoll, !wakeListener);
+      if (wakeListener) wakeListener->forwardTo(&rec);
     } catch (const std::exception& e) {
       Logger::instance().error(std::format("Failed to start recorder: {}", e.what()));
+      ui.close();
       continue;
     }
 
     auto startTime = std::chrono::steady_clock::now();
+    Metrics::instance().add(Metrics::Counter::Sessions);
+    Metrics::instance().observe(Metrics::Histogram::TriggerToRecord, startTime - triggerTime);
+    FlightRecorder::record("session.start", "ms",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(startTime - triggerTime).count());
     auto maxDuration = std::chrono::minutes(config.maxRecordTime);
     auto lastSpeechTime = std::chrono::steady_clock::now();
     bool isAutoPaused = false;
     bool finishAndTranscribe = false;
     bool appendSpace = true;
-    bool useTerminalPaste = false;
+    std::atomic<bool> useTerminalPaste = (action == "terminal"); // Also read by the stream's delivery thread
+    std::atomic<bool> useTyping = (action == "type");
 
     bool isPaused = false;
     bool isTimeout = false;
@@ -408,9 +829,43 @@ int main(int argc, char* argv[]) {
     std::chrono::steady_clock::duration totalAutoPausedDuration = std::chrono::seconds(0);
     auto lastAutoPauseStart = std::chrono::steady_clock::now();
 
+    // Streaming keeps only the uncommitted tail in sessionPcm; committed segments
+    // are transcribed and pasted in the background while no keys are held.
+    const size_t maxTail = (size_t)rec.getSampleRate() * 25; // Stay inside Whisper's 30s window
+    bool stripWake = !preRoll.empty();
+    std::atomic<size_t> segmentsPasted = 0;
+    auto pasteSegment = [&](const std::string& rawText) { // Runs on the stream's delivery thread
+      std::string text = trim(rawText);
+      if (stripWake && !text.empty()) {
+        // The wake phrase is part of the first segment only
+        text = trim(WakeWordListener::stripWakeWord(text, config.wakeWord));
+        stripWake = false;
+      }
+      if (!config.postProcessCommand.empty()) text = runPostProcess(config.postProcessCommand, text);
+      if (text.empty()) return;
+      text += " "; // Segments run on; the space separates them from the next one
+
+      if (config.logTranscriptions) {
+        Logger::instance().log("Transcribed: " + text);
+      }
+      if (useTyping) {
+        paster.type(text, activeWin, config.verbose);
+      } else {
+        paster.paste(text, activeWin, useTerminalPaste ? PasteStrategy::CtrlShiftV : PasteStrategy::CtrlV,
+                     config.verbose);
+      }
+      ++segmentsPasted;
+    };
+    std::unique_ptr<StreamCommitter> stream; // Declared last: its delivery thread uses the state above
+    if (streaming) {
+      stream = std::make_unique<StreamCommitter>(transcriber, pasteSegment);
+      Logger::instance().log("Streaming session: segments are pasted as they become final.");
+    }
+
     // 3. Recording Loop
     while (true) {
       auto now = std::chrono::steady_clock::now();
+      rec.drain(sessionPcm);
 
       // VAD Logic (Smart Pause)
       float currentLevel = rec.getCurrentLevel();
@@ -420,6 +875,8 @@ int main(int argc, char* argv[]) {
                isAutoPaused = false;
                rec.setWriting(true);
                totalAutoPausedDuration += (now - lastPauseStart);
+               TRACE_INSTANT("vad.resume");
+               FlightRecorder::record("vad.resume");
                Logger::instance().log("VAD: Voice detected. Resuming.");
            }
       }
@@ -428,7 +885,20 @@ int main(int argc, char* argv[]) {
            isAutoPaused = true;
            rec.setWriting(false);
            lastAutoPauseStart = now;
+           TRACE_INSTANT("vad.pause");
+           FlightRecorder::record("vad.pause");
+           Metrics::instance().add(Metrics::Counter::VadPauses);
            Logger::instance().log("VAD: Silence detected. Auto-pausing.");
+           // A pause ends a segment; very short tails wait for more speech
+           if (stream && sessionPcm.size() > rec.getSampleRate() / 2) {
+             stream->commit(Transcriber::resampleTo16k(sessionPcm, rec.getSampleRate()));
+             sessionPcm.clear();
+           }
+      }
+      if (stream && sessionPcm.size() >= maxTail) {
+        // No pause for too long: commit anyway rather than let the tail outgrow the model
+        stream->commit(Transcriber::resampleTo16k(sessionPcm, rec.getSampleRate()));
+        sessionPcm.clear();
       }
 
       // Calculate active recording duration
@@ -448,23 +918,22 @@ int main(int argc, char* argv[]) {
         isPaused = true;
         lastPauseStart = now;
         secondsLeft = 0;
+        FlightRecorder::record("session.timeout");
         Logger::instance().log("Recording time limit reached.");
       }
 
       // UI Color Updates
+      std::string background = "white";
       if (isTimeout) {
-        win.setBackgroundColor("red");
+        background = "red";
       } else if (isPaused || isAutoPaused) {
-        win.setBackgroundColor("white");
+        background = "white";
       } else {
         if (secondsLeft < 30) {
-          win.setBackgroundColor("red");
+          background = "red";
         }
         else if (secondsLeft < 60) {
-          win.setBackgroundColor("yellow");
-        }
-        else {
-          win.setBackgroundColor("white");
+          background = "yellow";
         }
       }
 
@@ -482,6 +951,10 @@ int main(int argc, char* argv[]) {
       } else {
         header = std::format("RECORDING... {:02d}:{:02d} remaining", minutes, seconds);
       }
+      if (stream) {
+        header += std::format("\nSTREAMING: {} segment(s) pasted{}", segmentsPasted.load(),
+                              stream->busy() ? ", transcribing..." : "");
+      }
 
       std::string status = std::format(R"( 
 {} 
@@ -490,18 +963,32 @@ Commands:
   v    Paste + Space
   s    Paste Only
   t    Terminal Paste
+  k    Type Out (no clipboard)
   r    Restart Session
   p    Pause / Resume
   +    Extend Time {} min
+  Enter Finish ({})
   a    Abort Transcribing
   x    Exit Program)", 
-          header, config.maxRecordTime);
+          header, config.maxRecordTime, action == "push-to-talk" ? "paste" : action);
 
-      win.updateText(status, rec.getCurrentLevel());
+      ui.publish({ status, background, rec.getCurrentLevel() });
 
       // 4. Handle Window Interaction
       char key = 0;
-      if (win.checkForInput(key)) {
+      bool haveKey = ui.pollKey(key);
+      if (stream) {
+        // The window has no focus while streaming; the session's trigger finishes it
+        // (any trigger does after a wake word, which has no binding of its own)
+        int fired = input.checkTrigger();
+        if (fired >= 0 && (sessionTrigger < 0 || fired == sessionTrigger) && !haveKey) {
+          key = '\r';
+          haveKey = true;
+        }
+        // Hold output back while the user is typing, so pasted text does not interleave
+        stream->hold(input.keysHeld());
+      }
+      if (haveKey) {
         if (key == '+') {
           maxDuration += std::chrono::minutes(config.maxRecordTime);
           if (isTimeout) {
@@ -530,22 +1017,35 @@ Commands:
           }
         } else if (key == 'r') {
           // Restart
+          Metrics::instance().add(Metrics::Counter::OverrunFrames, rec.getOverrunFrames()); // Reset by start()
+          if (wakeListener) wakeListener->forwardTo(nullptr);
           rec.stop();
-          rec.start(tempFile);
+          rec.start(tempFile, {}, !wakeListener);
+          if (wakeListener) wakeListener->forwardTo(&rec);
+          sessionPcm.clear();
+          if (stream) stream->cancel(); // Already pasted text stays
           startTime = std::chrono::steady_clock::now();
           maxDuration = std::chrono::minutes(config.maxRecordTime);
           totalPausedDuration = std::chrono::seconds(0);
           isPaused = false;
           isTimeout = false;
           lastSpeechTime = now;
+          FlightRecorder::record("session.restart");
           Logger::instance().log("Recording session restarted by user.");
-        } else if (key == 'v' || key == 's' || key == 't') {
+        } else if (key == 'v' || key == 's' || key == 't' || key == 'k' || key == '\r') {
+          if (key == '\r') {
+            // Finish with the action bound to the trigger that started the session
+            key = (action == "paste-only") ? 's' : (action == "terminal") ? 't' : (action == "type") ? 'k' : 'v';
+          }
           finishAndTranscribe = true;
-          appendSpace = (key == 'v' || key == 't');
+          appendSpace = (key == 'v' || key == 't' || key == 'k');
           useTerminalPaste = (key == 't');
+          useTyping = (key == 'k');
           break;
         } else if (key == 'a' || key == 27) { // 'a' or Esc
           Logger::instance().log("Recording aborted by user.");
+          Metrics::instance().add(Metrics::Counter::Aborts);
+          FlightRecorder::record("session.abort");
           break;
         } else if (key == 'x' || key == 3) { // 'x' or Ctrl+C
           Logger::instance().log("Exit requested by user via recording window.");
@@ -554,21 +1054,87 @@ Commands:
         }
       }
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if (pushToTalk) {
+        // Sleep on the key state instead, so the release is seen within a few ms
+        if (input.waitForRelease(std::chrono::milliseconds(100))) {
+          releaseTime = std::chrono::steady_clock::now();
+          finishAndTranscribe = true;
+          appendSpace = true;
+          Logger::instance().log("Push-to-talk released.");
+          break;
+        }
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
     }
 
     // 5. Finalize and Transcribe
+    auto stopTime = pushToTalk ? releaseTime : std::chrono::steady_clock::now();
+    if (wakeListener) wakeListener->forwardTo(nullptr); // Must stop feeding rec before it closes
     rec.stop();
-
-    if (finishAndTranscribe) {
-      win.setBackgroundColor("white");
-      win.updateText("Recognition in progress...");
-      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    rec.drain(sessionPcm); // Flush whatever the device delivered before it stopped
+    Metrics::instance().add(Metrics::Counter::OverrunFrames, rec.getOverrunFrames());
+    FlightRecorder::record("session.stop", "frames", (int64_t)sessionPcm.size(), "transcribe", finishAndTranscribe);
+
+    if (finishAndTranscribe && stream) {
+      ui.publish({ "Finishing..." });
+      if (rec.getOverrunFrames() > 0) {
+        Logger::instance().log(std::format("Capture ring overran by {} frames; the stream has gaps.",
+                                           rec.getOverrunFrames()));
+      }
+      try {
+        if (!sessionPcm.empty()) {
+          stream->commit(Transcriber::resampleTo16k(sessionPcm, rec.getSampleRate()));
+        }
+        // Let go of the finishing keys first, but don't wait on them for more than 2 s
+        auto holdLimit = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (stream->busy()) {
+          input.checkTrigger();
+          stream->hold(input.keysHeld() && std::chrono::steady_clock::now() < holdLimit);
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+      } catch (const std::exception& e) {
+        FlightRecorder::record("session.error");
+        Logger::instance().error(std::format("Streaming error: {}", e.what()));
+      }
+      Logger::instance().log(std::format("Streaming session finished: {} segment(s) pasted.", segmentsPasted.load()));
+      ui.close();
+    } else if (finishAndTranscribe) {
+      ui.publish({ "Recognition in progress..." });
 
       try {
-        Transcriber transcriber(modelPath);
-        std::string rawText = transcriber.transcribe(tempFile);
+        std::vector<float> pcm16k;
+        if (rec.getOverrunFrames() > 0) {
+          // The in-memory copy has gaps; fall back to the complete WAV file
+          Logger::instance().log(std::format("Capture ring overran by {} frames; transcribing from file.",
+                                             rec.getOverrunFrames()));
+          pcm16k = Transcriber::loadAudio(tempFile);
+        } else {
+          pcm16k = Transcriber::resampleTo16k(sessionPcm, rec.getSampleRate());
+        }
+
+        std::string rawText;
+        if (commands) {
+          CommandMatch match = recognizeCommand(transcriber, pcm16k, *commands, config);
+          rawText = match.matched ? match.id : "";
+        } else {
+          rawText = transcriber.transcribe(pcm16k);
+        }
         std::string text = trim(rawText);
+        auto textTime = std::chrono::steady_clock::now();
+        Metrics::instance().observe(Metrics::Histogram::StopToText, textTime - stopTime);
+        FlightRecorder::record("session.text", "ms",
+                               std::chrono::duration_cast<std::chrono::milliseconds>(textTime - stopTime).count(),
+                               "bytes", (int64_t)text.size());
+        if (pushToTalk) {
+          auto toText = std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - releaseTime);
+          Logger::instance().log(std::format("Push-to-talk: release-to-text {} ms.", toText.count()));
+        }
+        if (!preRoll.empty()) {
+          // The wake phrase itself is part of the pre-roll; don't paste it.
+          text = trim(WakeWordListener::stripWakeWord(text, config.wakeWord));
+        }
 
         if (!config.postProcessCommand.empty()) {
             Logger::instance().log("Running post-process: " + config.postProcessCommand);
@@ -588,39 +1154,46 @@ Commands:
             Logger::instance().log("Transcribed: " + text);
           }
 
-          win.close();
+          ui.close();
 
           // Paste text
-          Logger::instance().log("Pasting text...");
-          Paster paster;
-          paster.paste(text, activeWin, useTerminalPaste, config.verbose);
+          if (useTyping) {
+            Logger::instance().log("Typing text...");
+            paster.type(text, activeWin, config.verbose);
+          } else {
+            Logger::instance().log("Pasting text...");
+            paster.paste(text, activeWin, useTerminalPaste ? PasteStrategy::CtrlShiftV : PasteStrategy::CtrlV,
+                         config.verbose);
+          }
+          auto pasteTime = std::chrono::steady_clock::now();
+          Metrics::instance().observe(Metrics::Histogram::TextToPaste, pasteTime - textTime);
+          FlightRecorder::record("session.pasted", "ms",
+                                 std::chrono::duration_cast<std::chrono::milliseconds>(pasteTime - textTime).count(),
+                                 "typed", useTyping);
+
+          if (pushToTalk) {
+            auto toPaste = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - releaseTime);
+            Logger::instance().log(std::format("Push-to-talk: release-to-paste {} ms.", toPaste.count()));
+          }
         } else {
-          win.updateText("No speech detected.");
+          ui.publish({ "No speech detected." });
           Logger::instance().log("Transcription complete: No speech detected.");
           std::this_thread::sleep_for(std::chrono::seconds(1));
         }
 
       } catch (const std::exception& e) {
+        FlightRecorder::record("session.error");
         Logger::instance().error(std::format("Transcription error: {}", e.what()));
-        win.updateText("Error during transcription!");
+        ui.publish({ "Error during transcription!" });
         std::this_thread::sleep_for(std::chrono::seconds(2));
       }
     }
+    ui.close(); // Withdrawn until the next session
   }
 
   // Cleanup crash report file if no crash occurred and application exits normally
-  if (g_crash_report_fd != -1) {
-      close(g_crash_report_fd); // Close the file descriptor
-      // Attempt to remove the temp crash report file if it wasn't renamed due to a crash.
-      // This logic is tricky and might need refinement for full robustness.
-      // For now, we assume the crash handler handles the renaming/closing.
-      // If the application exits normally, we should clean up the temporary file.
-      std::error_code ec;
-      std::filesystem::remove(g_crash_report_filename, ec);
-      if (ec) {
-          Logger::instance().error("Failed to remove temporary crash report file: " + std::string(g_crash_report_filename) + " Error: " + ec.message());
-      }
-  }
+  cleanupCrashReport();
 
   return 0;
 }
@@ -0,0 +1,221 @@
+#ifndef VOICECLI_SRC_BATCHRUNNER_HPP
+#define VOICECLI_SRC_BATCHRUNNER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <glob.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "JsonLine.hpp"
+#include "Logger.hpp"
+#include "Transcriber.hpp"
+#include "WorkStealingQueue.hpp"
+
+/**
+ * @brief Transcribes many audio files in parallel over one set of model weights.
+ *
+ * Every worker thread owns its own whisper_state; files are spread over the
+ * workers largest-first and rebalanced through a WorkStealingQueue. Results are
+ * written as JSON lines, one per file, followed by an aggregate summary line.
+ */
+class BatchRunner {
+public:
+  /**
+   * @brief Prepares a batch run.
+   * @param transcriber A transcriber holding the shared weights.
+   * @param jobs Number of worker threads (0 = pick from hardware concurrency).
+   */
+  BatchRunner(Transcriber& transcriber, unsigned int jobs);
+
+  // Disable copying
+  BatchRunner(const BatchRunner&) = delete;
+  BatchRunner& operator=(const BatchRunner&) = delete;
+
+  /**
+   * @brief Expands a directory or glob pattern into a list of audio files.
+   *
+   * A directory yields its .wav, .flac and .mp3 files (not recursive). Anything
+   * else is passed to glob(3).
+   *
+   * @param pattern Directory path or glob pattern.
+   * @return The matching files, largest first.
+   */
+  static std::vector<std::string> collectFiles(const std::string& pattern);
+
+  /**
+   * @brief Transcribes all files and writes JSON lines to the output stream.
+   * @param files The files to transcribe.
+   * @param out Stream receiving the JSON lines (typically stdout).
+   * @return The number of files that failed.
+   */
+  int run(const std::vector<std::string>& files, FILE* out);
+
+private:
+  void emit(FILE* out, const std::string& line);
+  void worker(size_t index, whisper_state* state, WorkStealingQueue<std::string>& queue, FILE* out);
+
+  Transcriber& m_transcriber;
+  unsigned int m_jobs;
+  int m_threadsPerJob;
+  std::mutex m_outMutex;
+  std::atomic<int> m_failed;
+  std::atomic<int64_t> m_audioMs;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline BatchRunner::BatchRunner(Transcriber& transcriber, unsigned int jobs)
+    : m_transcriber(transcriber), m_jobs(jobs), m_threadsPerJob(1), m_failed(0), m_audioMs(0) {
+  unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+  if (m_jobs == 0) m_jobs = std::max(1u, hw / 4);
+}
+
+inline std::vector<std::string> BatchRunner::collectFiles(const std::string& pattern) {
+  namespace fs = std::filesystem;
+  std::vector<std::string> files;
+  std::error_code ec;
+
+  if (fs::is_directory(pattern, ec)) {
+    for (const auto& entry : fs::directory_iterator(pattern, ec)) {
+      if (!entry.is_regular_file()) continue;
+      std::string ext = entry.path().extension().string();
+      std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+      if (ext == ".wav" || ext == ".flac" || ext == ".mp3") {
+        files.push_back(entry.path().string());
+      }
+    }
+  } else {
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+      for (size_t i = 0; i < matches.gl_pathc; ++i) {
+        if (fs::is_regular_file(matches.gl_pathv[i], ec)) files.push_back(matches.gl_pathv[i]);
+      }
+    }
+    globfree(&matches);
+  }
+
+  // Largest first, so the long files start early and the short ones fill the gaps.
+  std::vector<std::pair<uintmax_t, std::string>> sized;
+  for (auto& f : files) {
+    uintmax_t size = fs::file_size(f, ec);
+    sized.emplace_back(ec ? 0 : size, std::move(f));
+  }
+  std::sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+  files.clear();
+  for (auto& s : sized) files.push_back(std::move(s.second));
+  return files;
+}
+
+inline void BatchRunner::emit(FILE* out, const std::string& line) {
+  std::lock_guard<std::mutex> lock(m_outMutex);
+  std::fputs(line.c_str(), out);
+  std::fputc('\n', out);
+  std::fflush(out);
+}
+
+inline int BatchRunner::run(const std::vector<std::string>& files, FILE* out) {
+  m_failed = 0;
+  m_audioMs = 0;
+  unsigned int wanted = std::max(1u, std::min<unsigned int>(m_jobs, (unsigned int)files.size()));
+  auto start = std::chrono::steady_clock::now();
+
+  // States first: the cores are shared among the workers that actually got one
+  std::vector<Transcriber::StatePtr> states;
+  for (unsigned int i = 0; i < wanted; ++i) {
+    try {
+      states.push_back(m_transcriber.createState());
+    } catch (const std::exception& e) {
+      Logger::instance().error(std::format("Batch: Worker {}: {}", i, e.what()));
+      break; // Out of memory for states; more attempts would fail too
+    }
+  }
+  unsigned int workers = (unsigned int)states.size();
+  unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+  m_threadsPerJob = (int)std::max(1u, hw / std::max(1u, workers));
+
+  if (workers == 0) {
+    for (const auto& file : files) {
+      ++m_failed;
+      emit(out, JsonLine().addString("file", file).addString("error", "no inference state").toString());
+    }
+  } else {
+    WorkStealingQueue<std::string> queue(workers);
+    for (size_t i = 0; i < files.size(); ++i) {
+      queue.push(i, files[i]);
+    }
+
+    Logger::instance().log(std::format("Batch: {} files on {} workers x {} threads.",
+                                       files.size(), workers, m_threadsPerJob));
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+      threads.emplace_back(&BatchRunner::worker, this, i, states[i].get(), std::ref(queue), out);
+    }
+    for (auto& t : threads) t.join();
+  }
+
+  double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double audioSec = m_audioMs.load() / 1000.0;
+
+  emit(out, JsonLine().addBool("summary", true)
+                .addInt("files", (int64_t)files.size())
+                .addInt("failed", m_failed.load())
+                .addInt("workers", workers)
+                .addInt("threads_per_worker", m_threadsPerJob)
+                .addNumber("audio_sec", audioSec)
+                .addNumber("wall_sec", wallSec)
+                .addNumber("rtf", audioSec > 0 ? wallSec / audioSec : 0.0, 4)
+                .addNumber("throughput_x", wallSec > 0 ? audioSec / wallSec : 0.0, 2)
+                .toString());
+  Logger::instance().log(std::format("Batch: Done. {:.1f}s of audio in {:.1f}s ({} failed).",
+                                     audioSec, wallSec, m_failed.load()));
+  return m_failed.load();
+}
+
+inline void BatchRunner::worker(size_t index, whisper_state* state, WorkStealingQueue<std::string>& queue,
+                                FILE* out) {
+  std::string file;
+  while (queue.pop(index, file)) {
+    try {
+      auto t0 = std::chrono::steady_clock::now();
+      std::vector<float> pcm = Transcriber::loadAudio(file);
+      auto t1 = std::chrono::steady_clock::now();
+      std::string text = m_transcriber.transcribe(pcm, state, m_threadsPerJob);
+      auto t2 = std::chrono::steady_clock::now();
+
+      double audioSec = pcm.size() / 16000.0;
+      double wallSec = std::chrono::duration<double>(t2 - t0).count();
+      m_audioMs += (int64_t)(audioSec * 1000.0);
+
+      auto start = text.find_first_not_of(" \t\n\r");
+      auto end = text.find_last_not_of(" \t\n\r");
+      text = (start == std::string::npos) ? "" : text.substr(start, end - start + 1);
+
+      emit(out, JsonLine().addString("file", file)
+                    .addInt("worker", (int64_t)index)
+                    .addNumber("audio_sec", audioSec)
+                    .addNumber("decode_ms", std::chrono::duration<double, std::milli>(t1 - t0).count(), 1)
+                    .addNumber("infer_ms", std::chrono::duration<double, std::milli>(t2 - t1).count(), 1)
+                    .addNumber("rtf", audioSec > 0 ? wallSec / audioSec : 0.0, 4)
+                    .addString("text", text)
+                    .toString());
+    } catch (const std::exception& e) {
+      ++m_failed;
+      Logger::instance().error(std::format("Batch: {}: {}", file, e.what()));
+      emit(out, JsonLine().addString("file", file).addString("error", e.what()).toString());
+    }
+  }
+}
+
+#endif // VOICECLI_SRC_BATCHRUNNER_HPP
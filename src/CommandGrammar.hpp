@@ -0,0 +1,269 @@
+#ifndef VOICECLI_SRC_COMMANDGRAMMAR_HPP
+#define VOICECLI_SRC_COMMANDGRAMMAR_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "whisper.h"
+
+/**
+ * @brief Result of a grammar-constrained command transcription.
+ */
+struct CommandMatch {
+  bool matched = false; // false if the phrase list was empty or nothing was decoded
+  std::string id;       // Output associated with the matched phrase
+  std::string phrase;   // The matched spoken phrase (normalized)
+  std::string heard;    // Raw decoded text
+  float score = 0.0f;   // Similarity x mean token probability, 0.0 - 1.0
+};
+
+/**
+ * @brief A fixed phrase list compiled into a Whisper decoding grammar.
+ *
+ * The phrase file has one entry per line in the form `spoken phrase = output`,
+ * e.g. `save file = :w` or `git status = git status`. Blank lines and lines
+ * starting with '#' are ignored. Several phrases may map to the same output.
+ *
+ * The phrases become a GBNF-equivalent grammar (case-insensitive letters, an
+ * optional leading space and trailing punctuation), and a logits filter forces
+ * end-of-text as soon as the decoded text completes a phrase that is not the
+ * prefix of a longer one.
+ */
+class CommandGrammar {
+public:
+  /**
+   * @brief Loads and compiles a phrase list.
+   * @param path Path to the phrase file.
+   * @throws std::runtime_error If the file cannot be read or holds no phrases.
+   */
+  explicit CommandGrammar(const std::string& path);
+
+  // Disable copying (the compiled rules point into member storage)
+  CommandGrammar(const CommandGrammar&) = delete;
+  CommandGrammar& operator=(const CommandGrammar&) = delete;
+
+  /**
+   * @brief Installs the grammar and the early-stop filter into decoding parameters.
+   *
+   * The grammar must outlive the whisper_full call made with these parameters.
+   */
+  void configure(whisper_full_params& wparams) const;
+
+  /**
+   * @brief Maps decoded text to the closest phrase.
+   * @param heard The decoded text.
+   * @param confidence Mean token probability of the decode (0.0 - 1.0).
+   * @return The best match and its score.
+   */
+  CommandMatch match(const std::string& heard, float confidence) const;
+
+  /**
+   * @brief Returns the number of phrases in the list.
+   */
+  size_t size() const;
+
+private:
+  struct Entry {
+    std::string phrase; // normalized
+    std::string id;
+  };
+
+  static void logits_filter(whisper_context* ctx, whisper_state* state, const whisper_token_data* tokens,
+                            int n_tokens, float* logits, void* user_data);
+  static size_t editDistance(const std::string& a, const std::string& b);
+  static std::string normalize(const std::string& text);
+
+  void compile();
+
+  std::vector<Entry> m_entries;
+  std::unordered_set<std::string> m_terminal; // Phrases after which decoding can stop at once
+  std::vector<std::vector<whisper_grammar_element>> m_rules;
+  std::vector<const whisper_grammar_element*> m_rulePtrs;
+  size_t m_maxPhraseLength;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline CommandGrammar::CommandGrammar(const std::string& path) : m_maxPhraseLength(0) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Failed to open command list: " + path);
+  }
+
+  std::string line;
+  while (std::getline(in, line)) {
+    auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') continue;
+
+    auto eq = line.find('=');
+    std::string phrase = normalize(line.substr(0, eq));
+    std::string id = (eq == std::string::npos) ? phrase : line.substr(eq + 1);
+    auto idStart = id.find_first_not_of(" \t");
+    auto idEnd = id.find_last_not_of(" \t\r");
+    id = (idStart == std::string::npos) ? "" : id.substr(idStart, idEnd - idStart + 1);
+
+    if (phrase.empty() || id.empty()) continue;
+    m_entries.push_back({ phrase, id });
+    m_maxPhraseLength = std::max(m_maxPhraseLength, phrase.size());
+  }
+
+  if (m_entries.empty()) {
+    throw std::runtime_error("Command list has no usable entries: " + path);
+  }
+  compile();
+}
+
+inline void CommandGrammar::compile() {
+  auto ch = [](uint32_t c) { return whisper_grammar_element{ WHISPER_GRETYPE_CHAR, c }; };
+  auto alt = [](uint32_t c) { return whisper_grammar_element{ WHISPER_GRETYPE_CHAR_ALT, c }; };
+  const whisper_grammar_element altSep{ WHISPER_GRETYPE_ALT, 0 };
+  const whisper_grammar_element end{ WHISPER_GRETYPE_END, 0 };
+
+  m_rules.assign(4, {});
+
+  // 0: root ::= lead phrases tail
+  m_rules[0] = { { WHISPER_GRETYPE_RULE_REF, 1 }, { WHISPER_GRETYPE_RULE_REF, 2 },
+                 { WHISPER_GRETYPE_RULE_REF, 3 }, end };
+
+  // 1: lead ::= " " | (empty)
+  m_rules[1] = { ch(' '), altSep, end };
+
+  // 2: phrases ::= "save file" | "git status" | ...  (letters match either case)
+  std::unordered_set<std::string> seen;
+  for (const auto& entry : m_entries) {
+    if (!seen.insert(entry.phrase).second) continue;
+    if (!m_rules[2].empty()) m_rules[2].push_back(altSep);
+    for (unsigned char c : entry.phrase) {
+      m_rules[2].push_back(ch(c));
+      if (std::isalpha(c)) m_rules[2].push_back(alt(std::toupper(c)));
+    }
+  }
+  m_rules[2].push_back(end);
+
+  // 3: tail ::= [.!?] | (empty)
+  m_rules[3] = { ch('.'), alt('!'), alt('?'), altSep, end };
+
+  m_rulePtrs.clear();
+  for (const auto& rule : m_rules) m_rulePtrs.push_back(rule.data());
+
+  // Decoding may stop at a phrase unless a longer phrase continues it
+  for (const auto& a : m_entries) {
+    bool isPrefix = false;
+    for (const auto& b : m_entries) {
+      if (b.phrase.size() > a.phrase.size() && b.phrase.compare(0, a.phrase.size() + 1, a.phrase + " ") == 0) {
+        isPrefix = true;
+        break;
+      }
+    }
+    if (!isPrefix) m_terminal.insert(a.phrase);
+  }
+}
+
+inline void CommandGrammar::configure(whisper_full_params& wparams) const {
+  wparams.grammar_rules = const_cast<const whisper_grammar_element**>(m_rulePtrs.data());
+  wparams.n_grammar_rules = m_rulePtrs.size();
+  wparams.i_start_rule = 0;
+  wparams.grammar_penalty = 100.0f;
+  wparams.no_timestamps = true;
+  wparams.single_segment = true;
+  wparams.max_tokens = (int)m_maxPhraseLength + 4; // Never more tokens than characters
+  wparams.logits_filter_callback = logits_filter;
+  wparams.logits_filter_callback_user_data = const_cast<CommandGrammar*>(this);
+}
+
+inline size_t CommandGrammar::editDistance(const std::string& a, const std::string& b) {
+  std::vector<size_t> prev(b.size() + 1), cur(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j) prev[j] = j;
+  for (size_t i = 1; i <= a.size(); ++i) {
+    cur[0] = i;
+    for (size_t j = 1; j <= b.size(); ++j) {
+      size_t cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+      cur[j] = std::min({ prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + cost });
+    }
+    std::swap(prev, cur);
+  }
+  return prev[b.size()];
+}
+
+/**
+ * @brief Whisper logits filter that ends decoding once a phrase is complete.
+ *
+ * Rebuilds the text decoded so far from the token history. If it equals a
+ * terminal phrase, every token but end-of-text is suppressed.
+ */
+inline void CommandGrammar::logits_filter(whisper_context* ctx, whisper_state* state,
+                                          const whisper_token_data* tokens, int n_tokens, float* logits,
+                                          void* user_data) {
+  (void)state;
+  const CommandGrammar* grammar = (const CommandGrammar*)user_data;
+  const whisper_token eot = whisper_token_eot(ctx);
+
+  std::string text;
+  for (int i = 0; i < n_tokens; ++i) {
+    if (tokens[i].id >= eot) continue; // Special and timestamp tokens
+    text += whisper_token_to_str(ctx, tokens[i].id);
+  }
+  if (text.empty() || !grammar->m_terminal.count(normalize(text))) return;
+
+  const int n_vocab = whisper_n_vocab(ctx);
+  for (int i = 0; i < n_vocab; ++i) {
+    if (i != eot) logits[i] = -INFINITY;
+  }
+}
+
+inline CommandMatch CommandGrammar::match(const std::string& heard, float confidence) const {
+  CommandMatch result;
+  result.heard = heard;
+
+  std::string target = normalize(heard);
+  if (target.empty()) return result;
+
+  size_t bestDistance = std::string::npos;
+  const Entry* best = nullptr;
+  for (const auto& entry : m_entries) {
+    size_t d = editDistance(target, entry.phrase);
+    if (d < bestDistance) {
+      bestDistance = d;
+      best = &entry;
+      if (d == 0) break;
+    }
+  }
+
+  size_t longest = std::max(target.size(), best->phrase.size());
+  float similarity = 1.0f - (float)bestDistance / (float)longest;
+
+  result.matched = true;
+  result.id = best->id;
+  result.phrase = best->phrase;
+  result.score = std::clamp(similarity * confidence, 0.0f, 1.0f);
+  return result;
+}
+
+inline std::string CommandGrammar::normalize(const std::string& text) {
+  std::string out;
+  bool pendingSpace = false;
+  for (unsigned char c : text) {
+    if (std::isalnum(c)) {
+      if (pendingSpace && !out.empty()) out += ' ';
+      pendingSpace = false;
+      out += (char)std::tolower(c);
+    } else if (std::isspace(c) || c == '-' || c == '_') {
+      pendingSpace = true;
+    }
+  }
+  return out;
+}
+
+inline size_t CommandGrammar::size() const {
+  return m_entries.size();
+}
+
+#endif // VOICECLI_SRC_COMMANDGRAMMAR_HPP
@@ -25,6 +25,26 @@ struct AppConfig {
   std::string postProcessCommand = "";
   bool showVersion = false;
   bool logTranscriptions = false; // New flag to control logging of transcriptions
+  bool headless = false;          // Run without X11, driven by line commands
+  std::string controlSocket = ""; // Unix socket for headless commands (empty = stdin)
+  std::string batchPattern = "";  // Directory or glob of audio files to transcribe offline
+  unsigned int batchJobs = 0;     // Batch worker threads (0 = auto)
+  std::string wakeWord = "";      // Spoken trigger phrase (empty = hotkey only)
+  std::string wakeModel = "models/ggml-tiny.en.bin"; // Small model used to confirm the wake word
+  std::string pushToTalkKey = ""; // Hold-to-talk key (empty = double-tap toggle)
+  std::string commandsFile = "";  // Phrase list for grammar-constrained command mode
+  float commandThreshold = 0.5f;  // Minimum match score for a command to be accepted
+  std::string inputBackend = "auto"; // Hotkey backend: auto, xi2 or poll
+  std::vector<std::string> triggers; // "spec=action" bindings (empty = derived from triggerKey)
+  bool stream = false;            // Paste each segment as soon as it is final
+  unsigned int uiFps = 10;        // Status window frame rate limit
+  bool spectrogram = false;       // Show a live spectrogram under the meter
+  std::string logFlush = "batch"; // Log flush policy: batch, interval or sync
+  unsigned int logMaxSizeMb = 10; // Rotate the log at this size (0 = no limit)
+  unsigned int logMaxAgeHours = 24; // Rotate the log at this age (0 = no limit)
+  unsigned int logKeep = 5;       // Rotated (compressed) generations to keep
+  std::string traceFile;          // Chrome trace output (empty = tracing off)
+  std::string metricsEndpoint;    // Unix socket path or loopback port (empty = not served)
 };
 
 /**
@@ -84,13 +104,33 @@ inline CommandLine::CommandLine(int argc, char* argv[]) {
     { "post-process", required_argument, 0, 'P' },
     { "version", no_argument, 0, 'V' },
     { "log-transcriptions", no_argument, 0, 'L' }, // New flag to control transcription logging
+    { "headless", no_argument, 0, 'H' },
+    { "control-socket", required_argument, 0, 'C' },
+    { "batch", required_argument, 0, 'B' },
+    { "jobs", required_argument, 0, 'j' },
+    { "wake-word", required_argument, 0, 'w' },
+    { "wake-model", required_argument, 0, 'W' },
+    { "push-to-talk", required_argument, 0, 'p' },
+    { "commands", required_argument, 0, 'c' },
+    { "command-threshold", required_argument, 0, 'E' },
+    { "input-backend", required_argument, 0, 'I' },
+    { "trigger", required_argument, 0, 'g' },
+    { "stream", no_argument, 0, 'R' },
+    { "ui-fps", required_argument, 0, 'F' },
+    { "spectrogram", no_argument, 0, 'A' },
+    { "log-flush", required_argument, 0, 'O' },
+    { "log-max-size", required_argument, 0, 'Z' },
+    { "log-max-age", required_argument, 0, 'Y' },
+    { "log-keep", required_argument, 0, 'K' },
+    { "trace", required_argument, 0, 'X' },
+    { "metrics", required_argument, 0, 'U' },
     { 0, 0, 0, 0 }
   };
 
   int opt;
   int option_index = 0;
 
-  while ((opt = getopt_long(argc, argv, "hld:m:M:r:tvS:T:k:P:VL", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "hld:m:M:r:tvS:T:k:P:VLHC:B:j:w:W:p:c:E:I:g:RF:AO:Z:Y:K:X:U:", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'h':
       m_config.showHelp = true;
@@ -160,6 +200,126 @@ inline CommandLine::CommandLine(int argc, char* argv[]) {
     case 'L':
       m_config.logTranscriptions = true;
       break;
+    case 'H':
+      m_config.headless = true;
+      break;
+    case 'C':
+      m_config.controlSocket = optarg;
+      m_config.headless = true;
+      break;
+    case 'B':
+      m_config.batchPattern = optarg;
+      break;
+    case 'j':
+      try {
+        m_config.batchJobs = std::stoul(optarg);
+      } catch (...) {
+        std::cerr << "Invalid job count provided. Using automatic worker count." << std::endl;
+      }
+      break;
+    case 'w':
+      m_config.wakeWord = optarg;
+      break;
+    case 'W':
+      m_config.wakeModel = optarg;
+      break;
+    case 'p':
+      m_config.pushToTalkKey = optarg;
+      break;
+    case 'c':
+      m_config.commandsFile = optarg;
+      break;
+    case 'E':
+      try {
+        float val = std::stof(optarg);
+        if (val < 0.0f || val > 1.0f) throw std::invalid_argument("out of range");
+        m_config.commandThreshold = val;
+      } catch (...) {
+        std::cerr << "Invalid command threshold (must be 0.0-1.0). Using default 0.5." << std::endl;
+      }
+      break;
+    case 'I':
+      if (std::string(optarg) == "auto" || std::string(optarg) == "xi2" || std::string(optarg) == "poll") {
+        m_config.inputBackend = optarg;
+      } else {
+        std::cerr << "Invalid input backend (auto, xi2 or poll). Using auto." << std::endl;
+      }
+      break;
+    case 'g': {
+      std::string binding = optarg;
+      auto eq = binding.rfind('=');
+      std::string action = (eq == std::string::npos) ? "" : binding.substr(eq + 1);
+      if (action == "paste" || action == "paste-only" || action == "terminal" || action == "type" ||
+          action == "push-to-talk") {
+        m_config.triggers.push_back(binding);
+      } else {
+        std::cerr << "Invalid trigger '" << binding << "' (expected <keys>=paste|paste-only|terminal|type|push-to-talk). Ignored." << std::endl;
+      }
+      break;
+    }
+    case 'R':
+      m_config.stream = true;
+      break;
+    case 'F':
+      try {
+        unsigned long fps = std::stoul(optarg);
+        if (fps < 1 || fps > 60) throw std::invalid_argument("out of range");
+        m_config.uiFps = (unsigned int)fps;
+      } catch (...) {
+        std::cerr << "Invalid UI frame rate (must be 1-60). Using default 10." << std::endl;
+      }
+      break;
+    case 'A':
+      m_config.spectrogram = true;
+      break;
+    case 'O':
+      if (std::string(optarg) == "batch" || std::string(optarg) == "interval" || std::string(optarg) == "sync") {
+        m_config.logFlush = optarg;
+      } else {
+        std::cerr << "Invalid log flush policy (batch, interval or sync). Using batch." << std::endl;
+      }
+      break;
+    case 'Z':
+      try {
+        unsigned long mb = std::stoul(optarg);
+        if (mb > 4096) throw std::invalid_argument("out of range");
+        m_config.logMaxSizeMb = (unsigned int)mb;
+      } catch (...) {
+        std::cerr << "Invalid log size limit (must be 0-4096 MB). Using default 10." << std::endl;
+      }
+      break;
+    case 'Y':
+      try {
+        unsigned long hours = std::stoul(optarg);
+        if (hours > 8760) throw std::invalid_argument("out of range");
+        m_config.logMaxAgeHours = (unsigned int)hours;
+      } catch (...) {
+        std::cerr << "Invalid log age limit (must be 0-8760 hours). Using default 24." << std::endl;
+      }
+      break;
+    case 'K':
+      try {
+        unsigned long keep = std::stoul(optarg);
+        if (keep > 100) throw std::invalid_argument("out of range");
+        m_config.logKeep = (unsigned int)keep;
+      } catch (...) {
+        std::cerr << "Invalid number of log generations (must be 0-100). Using default 5." << std::endl;
+      }
+      break;
+    case 'X':
+      m_config.traceFile = optarg;
+      break;
+    case 'U': {
+      std::string endpoint = optarg;
+      bool isPort = !endpoint.empty() && endpoint.find_first_not_of("0123456789") == std::string::npos;
+      if (endpoint.empty() || (isPort && (endpoint.size() > 5 || std::stoul(endpoint) < 1 ||
+                                          std::stoul(endpoint) > 65535))) {
+        std::cerr << "Invalid metrics endpoint (Unix socket path or port 1-65535). Metrics are not served." << std::endl;
+      } else {
+        m_config.metricsEndpoint = endpoint;
+      }
+      break;
+    }
     case '?':
       // getopt_long prints its own error message
       m_config.showHelp = true;
@@ -194,6 +354,26 @@ inline void CommandLine::printHelp() const {
             << "  -P, --post-process <cmd>  Shell command to process text before pasting\n"
             << "  -V, --version             Show version information and exit\n"
             << "  -L, --log-transcriptions  Enable logging of transcribed text (default: disabled)\n"
+            << "  -H, --headless            Run without X11; read commands from stdin, emit JSON events\n"
+            << "  -C, --control-socket <p>  Headless mode, reading commands from a Unix socket at <p>\n"
+            << "  -B, --batch <dir|glob>    Transcribe audio files offline, printing JSON lines\n"
+            << "  -j, --jobs <n>            Parallel batch workers (default: CPU count / 4)\n"
+            << "  -w, --wake-word <phrase>  Start sessions by voice instead of the double-tap hotkey\n"
+            << "  -W, --wake-model <path>   Small model used to confirm the wake word (default: models/ggml-tiny.en.bin)\n"
+            << "  -p, --push-to-talk <key>  Record while <key> is held; paste on release (e.g. F9, Super)\n"
+            << "  -c, --commands <file>     Command mode: decode only phrases from <file>, paste their output\n"
+            << "  -E, --command-threshold <val> Minimum command match score (0.0 to 1.0, default 0.5)\n"
+            << "  -g, --trigger <keys=act>  Bind a trigger to an action (repeatable), e.g. \"Ctrl+Alt+Space=terminal\"\n"
+            << "  -I, --input-backend <b>   Hotkey detection: auto, xi2 (XInput2 raw events) or poll (default: auto)\n"
+            << "  -R, --stream              Paste each sentence as soon as it is final, while recording continues\n"
+            << "  -F, --ui-fps <n>          Status window frame rate limit, 1-60 (default: 10)\n"
+            << "  -A, --spectrogram         Show a live spectrogram of the microphone under the volume meter\n"
+            << "  -O, --log-flush <policy>  When log lines are written: batch, interval (once per second) or sync (default: batch)\n"
+            << "  -Z, --log-max-size <MB>   Rotate voicecli.log at this size, 0 = no limit (default: 10)\n"
+            << "  -Y, --log-max-age <hours> Rotate voicecli.log at this age, 0 = no limit (default: 24)\n"
+            << "  -K, --log-keep <n>        Compressed log generations to keep (default: 5)\n"
+            << "  -X, --trace <file>        Record latency spans; write Chrome trace JSON to <file> at exit and on SIGUSR1\n"
+            << "  -U, --metrics <path|port> Serve latency histograms and counters (Prometheus text) on a Unix socket or 127.0.0.1:<port>\n"
             << std::endl;
 }
 
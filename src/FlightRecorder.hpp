@@ -0,0 +1,184 @@
+#ifndef VOICECLI_SRC_FLIGHTRECORDER_HPP
+#define VOICECLI_SRC_FLIGHTRECORDER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Always-on record of the most recent events, written into crash reports.
+ *
+ * Each event is a name plus up to two named integers (sizes, durations, device
+ * results), stamped with the thread ID and the coarse monotonic clock (a few
+ * ms resolution, but several times cheaper to read than the precise one;
+ * durations that matter are recorded as values). Events go into a fixed ring
+ * that any thread, including the audio callback, can append to without locks
+ * or allocation; the oldest entries are overwritten.
+ *
+ * dump() uses only write() and clock_gettime(), so the crash handler can call it
+ * while the rest of the process is in an unknown state. Entries being written
+ * at the moment of the crash are skipped rather than printed half-written.
+ */
+class FlightRecorder {
+public:
+  static constexpr size_t Size = 1024; // Events kept, power of two
+
+  /**
+   * @brief Appends an event.
+   * @param event A string literal (only the pointer is stored), e.g. "session.start".
+   * @param key1 A string literal naming value1, or nullptr.
+   * @param key2 A string literal naming value2, or nullptr.
+   */
+  static void record(const char* event, const char* key1 = nullptr, int64_t value1 = 0,
+                     const char* key2 = nullptr, int64_t value2 = 0);
+
+  /**
+   * @brief Writes the recorded events, oldest first, with their age at the time of the call.
+   *
+   * Async-signal-safe.
+   */
+  static void dump(int fd);
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> sequence; // Index + 1 once complete, 0 while being written
+    std::atomic<int64_t> time;      // CLOCK_MONOTONIC_COARSE, in nanoseconds
+    std::atomic<int32_t> tid;
+    std::atomic<const char*> event;
+    std::atomic<const char*> key1;
+    std::atomic<int64_t> value1;
+    std::atomic<const char*> key2;
+    std::atomic<int64_t> value2;
+  };
+
+  static void appendInt(char*& out, int64_t value);
+  static void appendString(char*& out, const char* end, const char* text);
+  static void writeAll(int fd, const char* data, size_t size);
+
+  inline static Slot s_slots[Size];
+  inline static std::atomic<uint64_t> s_head{ 0 }; // Events ever recorded
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Appends a signed decimal; the caller leaves room for 20 characters.
+ */
+inline void FlightRecorder::appendInt(char*& out, int64_t value) {
+  char digits[20];
+  int count = 0;
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  do {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) *out++ = '-';
+  while (count > 0) *out++ = digits[--count];
+}
+
+inline void FlightRecorder::appendString(char*& out, const char* end, const char* text) {
+  while (*text && out < end) *out++ = *text++;
+}
+
+inline void FlightRecorder::dump(int fd) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  int64_t now = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  uint64_t head = s_head.load(std::memory_order_acquire);
+  uint64_t first = head > Size ? head - Size : 0;
+
+  char line[256];
+  char* p = line;
+  const char* end = line + sizeof(line) - 64; // Room for the numbers and the newline
+  appendString(p, end, "Flight recorder (");
+  appendInt(p, (int64_t)(head - first));
+  appendString(p, end, " of ");
+  appendInt(p, (int64_t)head);
+  appendString(p, end, " events, oldest first, in ms before now):\n");
+  writeAll(fd, line, (size_t)(p - line));
+
+  for (uint64_t i = first; i < head; ++i) {
+    const Slot& slot = s_slots[i & (Size - 1)];
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    int64_t time = slot.time.load(std::memory_order_relaxed);
+    int32_t tid = slot.tid.load(std::memory_order_relaxed);
+    const char* event = slot.event.load(std::memory_order_relaxed);
+    const char* key1 = slot.key1.load(std::memory_order_relaxed);
+    int64_t value1 = slot.value1.load(std::memory_order_relaxed);
+    const char* key2 = slot.key2.load(std::memory_order_relaxed);
+    int64_t value2 = slot.value2.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (before != i + 1 || slot.sequence.load(std::memory_order_relaxed) != before || !event) continue;
+
+    // "  -1234.567 ms  [tid 4321]  event key1=value1 key2=value2"
+    p = line;
+    int64_t micros = now > time ? (now - time) / 1000 : 0;
+    *p++ = ' ';
+    *p++ = ' ';
+    *p++ = '-';
+    appendInt(p, micros / 1000);
+    *p++ = '.';
+    int64_t fraction = micros % 1000;
+    *p++ = (char)('0' + fraction / 100);
+    *p++ = (char)('0' + fraction / 10 % 10);
+    *p++ = (char)('0' + fraction % 10);
+    appendString(p, end, " ms  [tid ");
+    appendInt(p, tid);
+    appendString(p, end, "]  ");
+    appendString(p, end, event);
+    if (key1) {
+      *p++ = ' ';
+      appendString(p, end, key1);
+      *p++ = '=';
+      appendInt(p, value1);
+    }
+    if (key2) {
+      *p++ = ' ';
+      appendString(p, end, key2);
+      *p++ = '=';
+      appendInt(p, value2);
+    }
+    *p++ = '\n';
+    writeAll(fd, line, (size_t)(p - line));
+  }
+}
+
+inline void FlightRecorder::record(const char* event, const char* key1, int64_t value1, const char* key2,
+                                   int64_t value2) {
+  thread_local int32_t t_tid = 0;
+  if (!t_tid) t_tid = (int32_t)syscall(SYS_gettid);
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  int64_t time = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  uint64_t index = s_head.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = s_slots[index & (Size - 1)];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time.store(time, std::memory_order_relaxed);
+  slot.tid.store(t_tid, std::memory_order_relaxed);
+  slot.event.store(event, std::memory_order_relaxed);
+  slot.key1.store(key1, std::memory_order_relaxed);
+  slot.value1.store(value1, std::memory_order_relaxed);
+  slot.key2.store(key2, std::memory_order_relaxed);
+  slot.value2.store(value2, std::memory_order_relaxed);
+  slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+inline void FlightRecorder::writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    data += n;
+    size -= (size_t)n;
+  }
+}
+
+#endif // VOICECLI_SRC_FLIGHTRECORDER_HPP
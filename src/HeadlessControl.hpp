@@ -0,0 +1,211 @@
+#ifndef VOICECLI_SRC_HEADLESSCONTROL_HPP
+#define VOICECLI_SRC_HEADLESSCONTROL_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Line-oriented command channel for headless mode.
+ *
+ * Reads newline-terminated commands from stdin, or from a client connected to a
+ * Unix domain socket, and writes JSON-line events back to the same peer. Never
+ * touches X11, so it works on build servers and in containers.
+ */
+class HeadlessControl {
+public:
+  /**
+   * @brief Opens the command channel.
+   * @param socketPath Path of a Unix socket to listen on. If empty, stdin/stdout are used.
+   * @throws std::runtime_error If the socket cannot be created.
+   */
+  explicit HeadlessControl(const std::string& socketPath = "");
+  ~HeadlessControl();
+
+  // Disable copying
+  HeadlessControl(const HeadlessControl&) = delete;
+  HeadlessControl& operator=(const HeadlessControl&) = delete;
+
+  /**
+   * @brief Writes one event line to the current peer.
+   *
+   * Events are silently dropped while no socket client is connected.
+   *
+   * @param line A serialized JSON object (without trailing newline).
+   */
+  void emit(const std::string& line);
+
+  /**
+   * @brief Checks whether the channel can still deliver commands.
+   * @return false once stdin has reached EOF. A socket channel stays open.
+   */
+  bool isOpen() const;
+
+  /**
+   * @brief Waits for the next command line.
+   *
+   * @param outCommand Receives the command with surrounding whitespace removed.
+   * @param timeoutMs Maximum time to wait, in milliseconds.
+   * @return true if a command was read, false on timeout or EOF.
+   */
+  bool readCommand(std::string& outCommand, int timeoutMs);
+
+private:
+  void acceptClient();
+  void closeClient();
+  bool takeLine(std::string& outCommand);
+
+  std::string m_socketPath;
+  std::string m_buffer;
+  int m_listenFd;
+  int m_inFd;
+  int m_outFd;
+  bool m_open;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline HeadlessControl::HeadlessControl(const std::string& socketPath)
+    : m_socketPath(socketPath), m_listenFd(-1), m_inFd(STDIN_FILENO), m_outFd(STDOUT_FILENO),
+      m_open(true) {
+  if (m_socketPath.empty()) return;
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (m_socketPath.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Control socket path is too long: " + m_socketPath);
+  }
+  std::strncpy(addr.sun_path, m_socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m_listenFd < 0) {
+    throw std::runtime_error("Failed to create control socket.");
+  }
+  unlink(m_socketPath.c_str()); // Remove a stale socket from a previous run
+  if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 1) != 0) {
+    std::string err = std::strerror(errno);
+    close(m_listenFd);
+    throw std::runtime_error("Failed to listen on control socket " + m_socketPath + ": " + err);
+  }
+
+  m_inFd = -1;
+  m_outFd = -1;
+  Logger::instance().log("Headless: Listening on control socket " + m_socketPath);
+}
+
+inline HeadlessControl::~HeadlessControl() {
+  closeClient();
+  if (m_listenFd >= 0) {
+    close(m_listenFd);
+    unlink(m_socketPath.c_str());
+  }
+}
+
+inline void HeadlessControl::acceptClient() {
+  int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (fd < 0) return;
+
+  if (m_inFd >= 0) {
+    // One controller at a time; tell the newcomer and hang up.
+    const char busy[] = "{\"event\":\"error\",\"message\":\"controller already connected\"}\n";
+    send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+    close(fd);
+    return;
+  }
+  m_inFd = fd;
+  m_outFd = fd;
+  m_buffer.clear();
+  Logger::instance().log("Headless: Controller connected.");
+}
+
+inline void HeadlessControl::closeClient() {
+  if (m_listenFd < 0 || m_inFd < 0) return;
+  close(m_inFd);
+  m_inFd = -1;
+  m_outFd = -1;
+  Logger::instance().log("Headless: Controller disconnected.");
+}
+
+inline void HeadlessControl::emit(const std::string& line) {
+  if (m_outFd < 0) return;
+
+  std::string data = line + "\n";
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = (m_listenFd >= 0)
+        ? send(m_outFd, data.data() + written, data.size() - written, MSG_NOSIGNAL)
+        : write(m_outFd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      if (m_listenFd >= 0) closeClient();
+      return;
+    }
+    written += (size_t)n;
+  }
+}
+
+inline bool HeadlessControl::isOpen() const {
+  return m_open;
+}
+
+inline bool HeadlessControl::readCommand(std::string& outCommand, int timeoutMs) {
+  if (takeLine(outCommand)) return true;
+
+  pollfd fds[2];
+  int count = 0;
+  if (m_inFd >= 0) fds[count++] = { m_inFd, POLLIN, 0 };
+  if (m_listenFd >= 0) fds[count++] = { m_listenFd, POLLIN, 0 };
+
+  if (count == 0 || poll(fds, count, timeoutMs) <= 0) return false;
+
+  for (int i = 0; i < count; ++i) {
+    if (!fds[i].revents) continue;
+
+    if (fds[i].fd == m_listenFd) {
+      acceptClient();
+      continue;
+    }
+
+    char chunk[512];
+    ssize_t n = read(fds[i].fd, chunk, sizeof(chunk));
+    if (n > 0) {
+      m_buffer.append(chunk, (size_t)n);
+    } else if (n == 0 || errno != EINTR) {
+      // A last command without a trailing newline still counts at EOF
+      if (n == 0 && !m_buffer.empty() && m_buffer.back() != '\n') m_buffer += '\n';
+      if (m_listenFd >= 0) {
+        closeClient();
+      } else {
+        m_open = false;
+        m_inFd = -1;
+      }
+    }
+  }
+
+  return takeLine(outCommand);
+}
+
+inline bool HeadlessControl::takeLine(std::string& outCommand) {
+  auto pos = m_buffer.find('\n');
+  if (pos == std::string::npos) return false;
+
+  std::string line = m_buffer.substr(0, pos);
+  m_buffer.erase(0, pos + 1);
+
+  auto start = line.find_first_not_of(" \t\r");
+  auto end = line.find_last_not_of(" \t\r");
+  outCommand = (start == std::string::npos) ? "" : line.substr(start, end - start + 1);
+  return true;
+}
+
+#endif // VOICECLI_SRC_HEADLESSCONTROL_HPP
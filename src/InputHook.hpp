@@ -3,28 +3,46 @@
 
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
+#include <X11/extensions/XInput2.h>
 #include <chrono>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <algorithm>
-#include <cctype>
+#include <format>
+#include <poll.h>
+#include <sys/resource.h>
 
 #include "Logger.hpp"
+#include "Trace.hpp"
+#include "TriggerEngine.hpp"
+#include "X11Connection.hpp"
 
 /**
  * @brief Monitors global keyboard input for a specific trigger sequence.
- * 
- * Currently monitors for a double-tap on a specified modifier key (Shift, Control, Alt, Super).
- * Uses X11 XQueryKeymap to read keyboard state without grabbing the keyboard.
+ *
+ * Key events are fed to a TriggerEngine holding any number of compiled triggers
+ * (double-taps, chords, holds), each bound to an action.
+ *
+ * Two backends feed the same key-event stream without grabbing the keyboard:
+ * - XInput2 raw key events: blocks on the X connection and wakes only on real
+ *   press/release events (preferred).
+ * - XQueryKeymap polling every 10ms: fallback for servers without XInput 2.1.
  */
 class InputHook {
 public:
+  enum class Backend { Auto, XInput2, Polling };
+
   /**
-   * @brief Initializes connection to the X server.
-   * @throws std::runtime_error If X display cannot be opened.
+   * @brief Attaches to the shared input connection and selects the input backend.
+   * @param backend Auto prefers XInput2 and falls back to polling.
+   * @throws std::runtime_error If X display cannot be opened, or XInput2 was
+   *         requested explicitly and is unavailable.
    */
-  InputHook();
+  explicit InputHook(Backend backend = Backend::Auto);
   ~InputHook();
 
   // Disable copying
@@ -32,131 +50,314 @@ public:
   InputHook& operator=(const InputHook&) = delete;
 
   /**
-   * @brief Blocks and monitors input until the trigger sequence is detected.
-   * 
-   * @param keyName The name of the trigger key (e.g., "Shift", "Control"). Case-insensitive.
+   * @brief Returns the name of the active backend ("xinput2" or "polling").
+   */
+  const char* backendName() const;
+
+  /**
+   * @brief Feeds pending key events to the triggers without blocking.
+   *
+   * Lets a running session watch for its finishing trigger between other work.
+   *
+   * @return The index of the binding that fired, or -1.
+   */
+  int checkTrigger();
+
+  /**
+   * @brief Returns true if any key was down at the last event seen.
+   *
+   * Current after checkTrigger(); used to hold back output while the user types.
+   */
+  bool keysHeld() const;
+
+  /**
+   * @brief Blocks and monitors input until one of the configured triggers fires.
+   *
+   * Returns as soon as the trigger completes, possibly with keys still held;
+   * use waitForRelease() to detect the end of a push-to-talk hold.
+   *
    * @param verbose If true, prints debug info to stdout.
-   * @return true if triggered successfully, false if monitoring stopped or failed.
+   * @return The index of the binding that fired, or -1 if monitoring stopped or failed.
    */
-  bool monitor(const std::string& keyName, bool verbose = false);
+  int monitor(bool verbose = false);
+
+  /**
+   * @brief Compiles the trigger bindings that monitor() waits for.
+   * @param bindings Trigger descriptions and their actions (see TriggerEngine).
+   * @throws std::invalid_argument If a description is invalid.
+   */
+  void setTriggers(const std::vector<TriggerBinding>& bindings);
+
+  /**
+   * @brief Waits for the last key pressed before the trigger fired to be released.
+   *
+   * @param timeout Maximum time to wait.
+   * @return true if the key was released within the timeout.
+   */
+  bool waitForRelease(std::chrono::milliseconds timeout);
 
 private:
+  struct KeyEvent {
+    KeyCode code;
+    bool pressed;
+    std::chrono::steady_clock::time_point when;
+  };
+
+  static bool isPressed(const char* keyMap, KeyCode code);
+  static std::chrono::nanoseconds threadCpuTime();
+
+  bool nextKeyEvent(KeyEvent& ev, int timeoutMs);
+  bool nextPolledEvent(KeyEvent& ev, int timeoutMs);
+  bool nextRawEvent(KeyEvent& ev, int timeoutMs);
+  void reportDetection(const char* what, const KeyEvent& ev,
+                       std::chrono::steady_clock::time_point idleSince,
+                       std::chrono::nanoseconds cpuAtStart);
+  void resync();
+
   Display* m_display;
   bool m_running;
+  KeyCode m_heldKey;
+  bool m_useXInput2;
+  int m_xiOpcode;
+  char m_keyState[32];
+  std::deque<KeyEvent> m_polled;
+  std::unique_ptr<TriggerEngine> m_triggers;
 };
 
 // -----------------------------------------------------------------------------
 // Inline Implementations
 // -----------------------------------------------------------------------------
 
-inline InputHook::InputHook() : m_display(nullptr), m_running(false) {
-  m_display = XOpenDisplay(NULL);
-  if (!m_display) {
-    throw std::runtime_error("Failed to open X Display.");
+inline InputHook::InputHook(Backend backend)
+    : m_display(nullptr), m_running(false), m_heldKey(0), m_useXInput2(false), m_xiOpcode(0) {
+  std::memset(m_keyState, 0, sizeof(m_keyState));
+  m_display = X11Connection::instance().display(X11Connection::Channel::Input);
+
+  if (backend != Backend::Polling) {
+    // Announce 2.2: a 2.0 client gets no raw events on the root while another client holds a grab
+    // (menus, drags, full-screen games), so the hotkey would go deaf exactly then. 2.1 fixed that.
+    int event, error;
+    int major = 2, minor = 2;
+    if (XQueryExtension(m_display, "XInputExtension", &m_xiOpcode, &event, &error) &&
+        XIQueryVersion(m_display, &major, &minor) == Success && (major > 2 || (major == 2 && minor >= 1))) {
+      unsigned char mask[XIMaskLen(XI_RawKeyRelease)] = { 0 };
+      XISetMask(mask, XI_RawKeyPress);
+      XISetMask(mask, XI_RawKeyRelease);
+
+      XIEventMask evmask;
+      evmask.deviceid = XIAllMasterDevices;
+      evmask.mask_len = sizeof(mask);
+      evmask.mask = mask;
+      XISelectEvents(m_display, DefaultRootWindow(m_display), &evmask, 1);
+      XFlush(m_display);
+      m_useXInput2 = true;
+    } else if (backend == Backend::XInput2) {
+      throw std::runtime_error("XInput 2.1 or later is not available on this X server.");
+    }
   }
+  Logger::instance().log(std::format("InputHook: Using {} backend.", backendName()));
 }
 
 inline InputHook::~InputHook() {
-  if (m_display) {
-    XCloseDisplay(m_display);
+}
+
+inline const char* InputHook::backendName() const {
+  return m_useXInput2 ? "xinput2" : "polling";
+}
+
+inline int InputHook::checkTrigger() {
+  if (!m_triggers) return -1;
+  KeyEvent ev;
+  while (nextKeyEvent(ev, 0)) {
+    if (ev.pressed) m_heldKey = ev.code;
+    int fired = m_triggers->onKey(ev.code, ev.pressed, ev.when);
+    if (fired >= 0) {
+      Logger::instance().log(std::format("InputHook: Trigger '{}' detected during session.",
+                                         m_triggers->binding(fired).spec));
+      return fired;
+    }
   }
+  return m_triggers->onTimeout(std::chrono::steady_clock::now());
 }
 
-inline bool InputHook::monitor(const std::string& keyName, bool verbose) {
-  m_running = true;
-  
-  std::string lowerKey = keyName;
-  std::transform(lowerKey.begin(), lowerKey.end(), lowerKey.begin(),
-      [](unsigned char c){ return std::tolower(c); });
-  
-  KeySym symL = XK_Shift_L;
-  KeySym symR = XK_Shift_R;
-
-  if (lowerKey == "control") {
-      symL = XK_Control_L;
-      symR = XK_Control_R;
-  } else if (lowerKey == "alt") {
-      symL = XK_Alt_L;
-      symR = XK_Alt_R;
-  } else if (lowerKey == "super") {
-      symL = XK_Super_L;
-      symR = XK_Super_R;
-  } else if (lowerKey != "shift") {
-      std::cerr << "Warning: Unknown trigger key '" << keyName << "'. Defaulting to Shift." << std::endl;
+inline bool InputHook::isPressed(const char* keyMap, KeyCode code) {
+  return code != 0 && (keyMap[code / 8] & (1 << (code % 8)));
+}
+
+inline bool InputHook::keysHeld() const {
+  for (char byte : m_keyState) {
+    if (byte) return true;
   }
+  return false;
+}
 
-  KeyCode codeL = XKeysymToKeycode(m_display, symL);
-  KeyCode codeR = XKeysymToKeycode(m_display, symR);
+inline int InputHook::monitor(bool verbose) {
+  TRACE_SCOPE("InputHook::monitor");
+  m_running = true;
+  if (!m_triggers) {
+    Logger::instance().error("InputHook: No triggers configured.");
+    return -1;
+  }
 
   if (verbose) {
-    std::cout << "InputHook: Monitoring for " << keyName << " double-tap (Left or Right)..." << std::endl;
+    std::cout << "InputHook: Monitoring " << m_triggers->size() << " trigger(s)..." << std::endl;
+  }
+
+  resync();
+  m_triggers->reset(m_keyState);
+  auto idleSince = std::chrono::steady_clock::now();
+  auto cpuAtStart = threadCpuTime();
+
+  KeyEvent ev;
+  while (m_running) {
+    // Sleep until the next key event, or the next tap-window/hold deadline
+    int waitMs = -1;
+    auto deadline = m_triggers->nextDeadline();
+    if (deadline) {
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now());
+      waitMs = std::max<int>(0, (int)left.count());
+    }
+
+    int fired;
+    if (nextKeyEvent(ev, waitMs)) {
+      TRACE_SCOPE("InputHook::detect");
+      if (ev.pressed) m_heldKey = ev.code;
+      fired = m_triggers->onKey(ev.code, ev.pressed, ev.when);
+    } else {
+      TRACE_SCOPE("InputHook::detect");
+      ev.when = std::chrono::steady_clock::now();
+      fired = m_triggers->onTimeout(ev.when);
+    }
+
+    if (fired >= 0) {
+      TRACE_INSTANT("trigger");
+      const TriggerBinding& binding = m_triggers->binding(fired);
+      if (verbose) {
+        std::cout << "TRIGGER DETECTED (" << binding.spec << ")!" << std::endl;
+      }
+      Logger::instance().log(std::format("InputHook: Trigger '{}' detected ({}).", binding.spec, binding.action));
+      reportDetection(binding.spec.c_str(), ev, idleSince, cpuAtStart);
+      return fired;
+    }
   }
+  return -1;
+}
 
-  int state = 0;
-  auto lastTime = std::chrono::steady_clock::now();
-  const auto timeout = std::chrono::milliseconds(400);
+inline bool InputHook::nextKeyEvent(KeyEvent& ev, int timeoutMs) {
+  return m_useXInput2 ? nextRawEvent(ev, timeoutMs) : nextPolledEvent(ev, timeoutMs);
+}
 
-  KeyCode triggeringKey = 0;
+inline bool InputHook::nextPolledEvent(KeyEvent& ev, int timeoutMs) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
   char keyMap[32];
 
-  while (m_running) {
+  while (m_polled.empty()) {
     XQueryKeymap(m_display, keyMap);
-
-    bool isLPressed = (keyMap[codeL / 8] & (1 << (codeL % 8)));
-    bool isRPressed = (keyMap[codeR / 8] & (1 << (codeR % 8)));
-    
     auto now = std::chrono::steady_clock::now();
 
-    switch (state) {
-    case 0: // Idle
-      if (isLPressed) {
-        state = 1;
-        triggeringKey = codeL;
-      } else if (isRPressed) {
-        state = 1;
-        triggeringKey = codeR;
-      }
-      break;
-
-    case 1: // Waiting for release
-      {
-        bool stillPressed = (keyMap[triggeringKey / 8] & (1 << (triggeringKey % 8)));
-        if (!stillPressed) {
-          state = 2;
-          lastTime = now;
-        }
-      }
-      break;
-
-    case 2: // Waiting for second press
-      if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastTime) > timeout) {
-        state = 0;
-      } else {
-        bool rePressed = (keyMap[triggeringKey / 8] & (1 << (triggeringKey % 8)));
-        if (rePressed) {
-          state = 3;
+    // Turn every changed bit into an event
+    for (int byte = 0; byte < 32; ++byte) {
+      unsigned char changed = (unsigned char)(keyMap[byte] ^ m_keyState[byte]);
+      for (int bit = 0; changed && bit < 8; ++bit) {
+        if (changed & (1 << bit)) {
+          m_polled.push_back({ (KeyCode)(byte * 8 + bit), (bool)(keyMap[byte] & (1 << bit)), now });
         }
       }
-      break;
+    }
+    std::memcpy(m_keyState, keyMap, sizeof(m_keyState));
 
-    case 3: // Triggered
-      if (verbose) {
-        std::cout << "TRIGGER DETECTED (" << keyName << ")!" << std::endl;
-      }
-      Logger::instance().log(std::format("InputHook: {} double-tap trigger detected.", keyName));
-      
-      // Wait for release
-      while (true) {
-         XQueryKeymap(m_display, keyMap);
-         if (!(keyMap[triggeringKey / 8] & (1 << (triggeringKey % 8)))) break;
-         std::this_thread::sleep_for(std::chrono::milliseconds(10));
-      }
+    if (!m_polled.empty()) break;
+    if (timeoutMs >= 0 && now >= deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  ev = m_polled.front();
+  m_polled.pop_front();
+  return true;
+}
+
+inline bool InputHook::nextRawEvent(KeyEvent& ev, int timeoutMs) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  while (true) {
+    while (XPending(m_display) > 0) {
+      XEvent xev;
+      XNextEvent(m_display, &xev);
+      XGenericEventCookie* cookie = &xev.xcookie;
+      if (cookie->type != GenericEvent || cookie->extension != m_xiOpcode) continue;
+      if (!XGetEventData(m_display, cookie)) continue;
+
+      bool isKey = (cookie->evtype == XI_RawKeyPress || cookie->evtype == XI_RawKeyRelease);
+      KeyCode code = isKey ? (KeyCode)((XIRawEvent*)cookie->data)->detail : 0;
+      bool pressed = (cookie->evtype == XI_RawKeyPress);
+      XFreeEventData(m_display, cookie);
+      if (!isKey) continue;
+
+      // Raw events include auto-repeat; only report real state changes
+      if (isPressed(m_keyState, code) == pressed) continue;
+      if (pressed) m_keyState[code / 8] |= (char)(1 << (code % 8));
+      else m_keyState[code / 8] &= (char)~(1 << (code % 8));
+
+      ev = { code, pressed, std::chrono::steady_clock::now() };
       return true;
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int waitMs = -1;
+    if (timeoutMs >= 0) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) return false;
+      waitMs = (int)left.count();
+    }
+
+    pollfd pfd = { ConnectionNumber(m_display), POLLIN, 0 };
+    if (poll(&pfd, 1, waitMs) == 0) return false;
   }
-  return false;
+}
+
+inline void InputHook::reportDetection(const char* what, const KeyEvent& ev,
+                                       std::chrono::steady_clock::time_point idleSince,
+                                       std::chrono::nanoseconds cpuAtStart) {
+  auto now = std::chrono::steady_clock::now();
+  double idleSec = std::chrono::duration<double>(now - idleSince).count();
+  double cpuSec = std::chrono::duration<double>(threadCpuTime() - cpuAtStart).count();
+  double decisionMs = std::chrono::duration<double, std::milli>(now - ev.when).count();
+
+  // With polling, the key changed up to one 10ms interval before we sampled it
+  Logger::instance().log(std::format(
+      "InputHook[{}]: {} after {:.1f}s idle, CPU {:.3f}% of one core, event-to-trigger {:.2f} ms{}.",
+      backendName(), what, idleSec, idleSec > 0 ? 100.0 * cpuSec / idleSec : 0.0, decisionMs,
+      m_useXInput2 ? "" : " (+ up to 10 ms sampling delay)"));
+}
+
+inline void InputHook::resync() {
+  // Drop events queued while we were not watching and start from the real key state
+  if (m_useXInput2) XSync(m_display, True);
+  m_polled.clear();
+  XQueryKeymap(m_display, m_keyState);
+}
+
+inline void InputHook::setTriggers(const std::vector<TriggerBinding>& bindings) {
+  m_triggers = std::make_unique<TriggerEngine>(m_display, bindings);
+}
+
+inline std::chrono::nanoseconds InputHook::threadCpuTime() {
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+inline bool InputHook::waitForRelease(std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  KeyEvent ev;
+
+  while (isPressed(m_keyState, m_heldKey)) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) return false;
+    if (!nextKeyEvent(ev, (int)left.count())) return false;
+  }
+  m_heldKey = 0;
+  return true;
 }
 
 #endif // VOICECLI_SRC_INPUTHOOK_HPP
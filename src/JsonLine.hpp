@@ -0,0 +1,128 @@
+#ifndef VOICECLI_SRC_JSONLINE_HPP
+#define VOICECLI_SRC_JSONLINE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * @brief Builds a single flat JSON object, suitable for JSON-lines output.
+ *
+ * Fields are appended in call order. Only flat objects with string, integer,
+ * floating point and boolean values are supported, which is all the event
+ * streams need.
+ */
+class JsonLine {
+public:
+  JsonLine() = default;
+
+  /**
+   * @brief Appends a boolean field.
+   */
+  JsonLine& addBool(const std::string& key, bool value);
+
+  /**
+   * @brief Appends an integer field.
+   */
+  JsonLine& addInt(const std::string& key, int64_t value);
+
+  /**
+   * @brief Appends a floating point field; NaN and infinities, which JSON cannot express, become null.
+   * @param precision Number of digits after the decimal point.
+   */
+  JsonLine& addNumber(const std::string& key, double value, int precision = 3);
+
+  /**
+   * @brief Appends a string field. The value is escaped.
+   */
+  JsonLine& addString(const std::string& key, const std::string& value);
+
+  /**
+   * @brief Escapes a string for use inside a JSON string literal (without quotes).
+   */
+  static std::string escape(const std::string& s);
+
+  /**
+   * @brief Returns the serialized object, without a trailing newline.
+   */
+  std::string toString() const;
+
+private:
+  void appendKey(const std::string& key);
+
+  std::string m_body;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline JsonLine& JsonLine::addBool(const std::string& key, bool value) {
+  appendKey(key);
+  m_body += value ? "true" : "false";
+  return *this;
+}
+
+inline JsonLine& JsonLine::addInt(const std::string& key, int64_t value) {
+  appendKey(key);
+  m_body += std::to_string(value);
+  return *this;
+}
+
+inline JsonLine& JsonLine::addNumber(const std::string& key, double value, int precision) {
+  appendKey(key);
+  if (!std::isfinite(value)) {
+    m_body += "null";
+    return *this;
+  }
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+  m_body += buffer;
+  return *this;
+}
+
+inline JsonLine& JsonLine::addString(const std::string& key, const std::string& value) {
+  appendKey(key);
+  m_body += '"';
+  m_body += escape(value);
+  m_body += '"';
+  return *this;
+}
+
+inline void JsonLine::appendKey(const std::string& key) {
+  if (!m_body.empty()) m_body += ',';
+  m_body += '"';
+  m_body += escape(key);
+  m_body += "\":";
+}
+
+inline std::string JsonLine::escape(const std::string& s) {
+  std::string out;
+  out.reserve(s.size() + 8);
+  for (unsigned char c : s) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned int)c);
+          out += buffer;
+        } else {
+          out += (char)c;
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+inline std::string JsonLine::toString() const {
+  return "{" + m_body + "}";
+}
+
+#endif // VOICECLI_SRC_JSONLINE_HPP
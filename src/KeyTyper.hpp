@@ -0,0 +1,234 @@
+#ifndef VOICECLI_SRC_KEYTYPER_HPP
+#define VOICECLI_SRC_KEYTYPER_HPP
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Types text as synthetic key events through XTest.
+ *
+ * For targets that ignore the clipboard (remote-desktop viewers, some terminals,
+ * protected input fields). The current keyboard mapping is turned once into a
+ * code point -> (keycode, shift) table. Characters the layout cannot produce
+ * are bound for the moment to spare keycodes (ones with no symbols) and put
+ * back afterwards. Key events are queued and flushed in batches.
+ */
+class KeyTyper {
+public:
+  /**
+   * @brief Builds the code point table from the server's keyboard mapping.
+   * @param display The connection to send events on; must outlive the typer.
+   */
+  explicit KeyTyper(Display* display);
+  ~KeyTyper();
+
+  // Disable copying
+  KeyTyper(const KeyTyper&) = delete;
+  KeyTyper& operator=(const KeyTyper&) = delete;
+
+  /**
+   * @brief Re-reads the keyboard mapping (after a layout change).
+   */
+  void refresh();
+
+  /**
+   * @brief Types UTF-8 text into whichever window has the focus.
+   * @return Number of characters typed.
+   */
+  size_t type(const std::string& text);
+
+private:
+  struct KeyStroke {
+    KeyCode code;
+    bool shift;
+  };
+
+  static std::vector<uint32_t> decodeUtf8(const std::string& text);
+  static KeySym keysymFor(uint32_t cp);
+  static uint32_t codepointFor(KeySym sym);
+
+  KeyCode bindSpare(uint32_t cp);
+  void releaseSpares();
+
+  Display* m_display;
+  KeyCode m_shift;
+  std::unordered_map<uint32_t, KeyStroke> m_table;  // Code point -> key
+  std::vector<KeyCode> m_spares;                    // Keycodes with no symbols
+  std::unordered_map<uint32_t, KeyCode> m_bound;    // Code points currently on spares
+  size_t m_nextSpare;
+  size_t m_bindsSinceSync;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline KeyTyper::KeyTyper(Display* display)
+    : m_display(display), m_shift(0), m_nextSpare(0), m_bindsSinceSync(0) {
+  refresh();
+}
+
+inline KeyTyper::~KeyTyper() {
+  releaseSpares();
+}
+
+/**
+ * @brief Puts a code point on the next spare keycode.
+ *
+ * A spare is reused round-robin. Before one is rebound in the same run, the
+ * queued events are synced and the clients get a moment to process the previous
+ * MappingNotify, so an already-sent key is not read with its new symbol.
+ */
+inline KeyCode KeyTyper::bindSpare(uint32_t cp) {
+  auto bound = m_bound.find(cp);
+  if (bound != m_bound.end()) return bound->second;
+  if (m_spares.empty()) return 0;
+
+  if (m_bindsSinceSync == m_spares.size()) {
+    XSync(m_display, False);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    m_bindsSinceSync = 0;
+  }
+
+  KeyCode code = m_spares[m_nextSpare];
+  m_nextSpare = (m_nextSpare + 1) % m_spares.size();
+  for (auto it = m_bound.begin(); it != m_bound.end(); ++it) {
+    if (it->second == code) {
+      m_bound.erase(it);
+      break;
+    }
+  }
+
+  KeySym sym = keysymFor(cp);
+  KeySym syms[2] = { sym, sym };
+  XChangeKeyboardMapping(m_display, code, 2, syms, 1);
+  m_bound[cp] = code;
+  ++m_bindsSinceSync;
+  return code;
+}
+
+inline uint32_t KeyTyper::codepointFor(KeySym sym) {
+  if ((sym >= 0x20 && sym <= 0x7e) || (sym >= 0xa0 && sym <= 0xff)) return (uint32_t)sym; // Latin-1
+  if ((sym & 0xff000000) == 0x01000000) return (uint32_t)(sym & 0x00ffffff);             // Unicode keysyms
+  if (sym == XK_Return) return '\n';
+  if (sym == XK_Tab) return '\t';
+  return 0;
+}
+
+inline std::vector<uint32_t> KeyTyper::decodeUtf8(const std::string& text) {
+  std::vector<uint32_t> out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size();) {
+    unsigned char c = text[i];
+    if (c >= 0x80 && c < 0xc0) { // Stray continuation byte
+      ++i;
+      continue;
+    }
+    int extra = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+    uint32_t cp = (extra == 0) ? c : (c & (0x3f >> extra));
+    if (i + extra >= text.size()) break; // Truncated sequence
+    for (int k = 1; k <= extra; ++k) cp = (cp << 6) | (text[i + k] & 0x3f);
+    i += extra + 1;
+    if (cp != '\r') out.push_back(cp);
+  }
+  return out;
+}
+
+inline KeySym KeyTyper::keysymFor(uint32_t cp) {
+  if (cp == '\n') return XK_Return;
+  if (cp == '\t') return XK_Tab;
+  if ((cp >= 0x20 && cp <= 0x7e) || (cp >= 0xa0 && cp <= 0xff)) return cp;
+  return 0x01000000 | cp;
+}
+
+inline void KeyTyper::refresh() {
+  releaseSpares();
+  m_table.clear();
+  m_spares.clear();
+
+  int minCode, maxCode, symsPerCode;
+  XDisplayKeycodes(m_display, &minCode, &maxCode);
+  KeySym* map = XGetKeyboardMapping(m_display, (KeyCode)minCode, maxCode - minCode + 1, &symsPerCode);
+  if (!map) return;
+
+  for (int code = minCode; code <= maxCode; ++code) {
+    KeySym* syms = map + (code - minCode) * symsPerCode;
+    bool empty = true;
+    // Levels 1 and 2 only: plain and shifted. Deeper levels need AltGr and are remapped instead.
+    for (int level = 0; level < symsPerCode; ++level) {
+      if (syms[level] != NoSymbol) empty = false;
+      if (level > 1) continue;
+      uint32_t cp = codepointFor(syms[level]);
+      if (cp == 0) continue;
+      auto it = m_table.find(cp);
+      if (it == m_table.end() || (it->second.shift && level == 0)) {
+        m_table[cp] = { (KeyCode)code, level == 1 };
+      }
+    }
+    if (empty) m_spares.push_back((KeyCode)code);
+  }
+  XFree(map);
+
+  m_shift = XKeysymToKeycode(m_display, XK_Shift_L);
+  Logger::instance().log(std::format("KeyTyper: {} characters on the layout, {} spare keycodes.",
+                                     m_table.size(), m_spares.size()));
+}
+
+inline void KeyTyper::releaseSpares() {
+  if (m_bound.empty()) return;
+  XSync(m_display, False);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Let clients read the last keys first
+
+  KeySym none[2] = { NoSymbol, NoSymbol };
+  for (const auto& [cp, code] : m_bound) {
+    XChangeKeyboardMapping(m_display, code, 2, none, 1);
+  }
+  m_bound.clear();
+  m_bindsSinceSync = 0;
+  XFlush(m_display);
+}
+
+inline size_t KeyTyper::type(const std::string& text) {
+  const size_t batch = 64; // Characters per XFlush
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint32_t> chars = decodeUtf8(text);
+  size_t typed = 0;
+
+  for (size_t i = 0; i < chars.size(); ++i) {
+    KeyStroke stroke{ 0, false };
+    auto it = m_table.find(chars[i]);
+    if (it != m_table.end()) {
+      stroke = it->second;
+    } else {
+      stroke.code = bindSpare(chars[i]);
+    }
+    if (stroke.code == 0) continue; // No spare keycodes left on this server
+
+    if (stroke.shift) XTestFakeKeyEvent(m_display, m_shift, True, 0);
+    XTestFakeKeyEvent(m_display, stroke.code, True, 0);
+    XTestFakeKeyEvent(m_display, stroke.code, False, 0);
+    if (stroke.shift) XTestFakeKeyEvent(m_display, m_shift, False, 0);
+    ++typed;
+
+    if (typed % batch == 0) XFlush(m_display);
+  }
+  XSync(m_display, False);
+  releaseSpares();
+
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  Logger::instance().log(std::format("KeyTyper: Typed {} characters in {:.1f} ms ({:.0f} chars/s).",
+                                     typed, sec * 1000.0, sec > 0 ? typed / sec : 0.0));
+  return typed;
+}
+
+#endif // VOICECLI_SRC_KEYTYPER_HPP
@@ -0,0 +1,227 @@
+#ifndef VOICECLI_SRC_LOGROTATOR_HPP
+#define VOICECLI_SRC_LOGROTATOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * @brief Retires full log files into a bounded set of compressed generations.
+ *
+ * A retired log is renamed right away to `<log>.<YYYYMMDD-HHMMSS>` (the time
+ * it was retired), which is all the logging path waits for. A background
+ * thread at idle priority then gzips every uncompressed generation next to the
+ * log into `<generation>.gz` and deletes the oldest generations beyond the
+ * configured count. Generations left uncompressed by an earlier run (e.g. one
+ * that exited mid-compression) are picked up by the next pass.
+ *
+ * Errors go to stderr only: this class sits underneath the Logger.
+ */
+class LogRotator {
+public:
+  LogRotator();
+  ~LogRotator();
+
+  // Disable copying
+  LogRotator(const LogRotator&) = delete;
+  LogRotator& operator=(const LogRotator&) = delete;
+
+  /**
+   * @brief Sets the limits.
+   * @param maxBytes Size at which the log is retired (0 = no limit).
+   * @param maxAge Age at which the log is retired (0 = no limit).
+   * @param keep Number of generations to keep besides the live log.
+   */
+  void configure(uint64_t maxBytes, std::chrono::seconds maxAge, unsigned int keep);
+
+  /**
+   * @brief Returns true when a log of this size, opened at this time, should be retired.
+   */
+  bool due(uint64_t size, std::chrono::steady_clock::time_point openedAt) const;
+
+  /**
+   * @brief Renames a closed log into a new generation and schedules compression.
+   * @param path The log file; it no longer exists afterwards.
+   */
+  void retire(const std::string& path);
+
+private:
+  void compress(const std::filesystem::path& source);
+  void prune(const std::filesystem::path& log);
+  void worker();
+
+  std::atomic<uint64_t> m_maxBytes;
+  std::atomic<int64_t> m_maxAgeSeconds;
+  std::atomic<unsigned int> m_keep;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<std::filesystem::path> m_logs; // Logs whose generations need a pass
+  std::atomic<bool> m_stop;
+  std::thread m_thread;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline LogRotator::LogRotator()
+    : m_maxBytes(10ull << 20), m_maxAgeSeconds(24 * 3600), m_keep(5), m_stop(false) {
+}
+
+inline LogRotator::~LogRotator() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_thread.joinable()) m_thread.join();
+}
+
+/**
+ * @brief Gzips one generation via a temporary file; gives up early when stopping.
+ */
+inline void LogRotator::compress(const std::filesystem::path& source) {
+  std::string target = source.string() + ".gz";
+  std::string temp = target + ".tmp";
+  std::ifstream in(source, std::ios::binary);
+  gzFile out = gzopen(temp.c_str(), "wb6");
+  if (!in || !out) {
+    std::cerr << "LogRotator: Cannot compress " << source << std::endl;
+    if (out) gzclose(out);
+    return;
+  }
+
+  std::vector<char> buffer(64 * 1024);
+  bool ok = true;
+  while (ok && in) {
+    in.read(buffer.data(), (std::streamsize)buffer.size());
+    std::streamsize n = in.gcount();
+    if (n > 0 && gzwrite(out, buffer.data(), (unsigned)n) != (int)n) ok = false;
+    if (m_stop.load(std::memory_order_relaxed)) ok = false; // Left for the next run
+  }
+  if (gzclose(out) != Z_OK) ok = false;
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, target, ec);
+    if (!ec) std::filesystem::remove(source, ec);
+  }
+  if (!ok || ec) std::filesystem::remove(temp, ec);
+}
+
+inline void LogRotator::configure(uint64_t maxBytes, std::chrono::seconds maxAge, unsigned int keep) {
+  m_maxBytes = maxBytes;
+  m_maxAgeSeconds = maxAge.count();
+  m_keep = keep;
+}
+
+inline bool LogRotator::due(uint64_t size, std::chrono::steady_clock::time_point openedAt) const {
+  uint64_t maxBytes = m_maxBytes.load(std::memory_order_relaxed);
+  if (maxBytes > 0 && size >= maxBytes) return true;
+  int64_t maxAge = m_maxAgeSeconds.load(std::memory_order_relaxed);
+  return maxAge > 0 && size > 0 && std::chrono::steady_clock::now() - openedAt >= std::chrono::seconds(maxAge);
+}
+
+/**
+ * @brief Deletes the oldest generations of a log beyond the limit, then compresses the uncompressed rest.
+ */
+inline void LogRotator::prune(const std::filesystem::path& log) {
+  std::string prefix = log.filename().string() + ".";
+  std::error_code ec;
+  std::vector<std::filesystem::path> plain;
+  std::vector<std::filesystem::path> generations;
+  for (const auto& entry : std::filesystem::directory_iterator(log.parent_path(), ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) != 0 || name.ends_with(".tmp")) continue;
+    generations.push_back(entry.path());
+    if (!name.ends_with(".gz")) plain.push_back(entry.path());
+  }
+
+  // Newest first: the names sort by their timestamps once ".gz" is ignored
+  auto stem = [](const std::filesystem::path& p) {
+    std::string s = p.filename().string();
+    return s.ends_with(".gz") ? s.substr(0, s.size() - 3) : s;
+  };
+  std::sort(generations.begin(), generations.end(),
+            [&](const auto& a, const auto& b) { return stem(a) > stem(b); });
+  unsigned int keep = m_keep.load();
+  for (size_t i = keep; i < generations.size(); ++i) {
+    std::filesystem::remove(generations[i], ec);
+  }
+
+  for (const auto& path : plain) {
+    if (m_stop.load()) return;
+    if (std::filesystem::exists(path, ec)) compress(path);
+  }
+}
+
+inline void LogRotator::retire(const std::string& path) {
+  std::time_t now = std::time(nullptr);
+  std::tm tm;
+  localtime_r(&now, &tm);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+  // Two retirements within a second get a counter, zero-padded so names keep sorting by age
+  std::string generation = path + "." + stamp;
+  std::error_code ec;
+  for (int n = 2; std::filesystem::exists(generation, ec) || std::filesystem::exists(generation + ".gz", ec); ++n) {
+    char counter[16];
+    std::snprintf(counter, sizeof(counter), "-%03d", n);
+    generation = path + "." + stamp + counter;
+  }
+  std::filesystem::rename(path, generation, ec);
+  if (ec) {
+    std::cerr << "LogRotator: Cannot rename " << path << ": " << ec.message() << std::endl;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::filesystem::path log = std::filesystem::absolute(path, ec);
+    if (std::find(m_logs.begin(), m_logs.end(), log) == m_logs.end()) m_logs.push_back(log);
+    if (!m_thread.joinable()) m_thread = std::thread(&LogRotator::worker, this);
+  }
+  m_cv.notify_all();
+}
+
+/**
+ * @brief Background thread: one compress-and-prune pass per batch of retirements.
+ */
+inline void LogRotator::worker() {
+  // Idle priority: compression only uses CPU nobody else wants
+  sched_param param{};
+  if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+    setpriority(PRIO_PROCESS, 0, 19); // Applies to this thread only on Linux
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this] { return m_stop || !m_logs.empty(); });
+    if (m_stop) return;
+    std::vector<std::filesystem::path> logs;
+    logs.swap(m_logs);
+    lock.unlock();
+
+    for (const auto& log : logs) prune(log);
+
+    lock.lock();
+  }
+}
+
+#endif // VOICECLI_SRC_LOGROTATOR_HPP
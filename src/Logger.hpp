@@ -2,85 +2,193 @@
 #define VOICECLI_SRC_LOGGER_HPP
 
 #include <string>
-#include <fstream>
 #include <iostream>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
 #include <format>
+#include <memory>
 #include <mutex>
 #include <filesystem>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LogRotator.hpp"
+#include "Timestamp.hpp"
 
 /**
  * @brief Thread-safe singleton logger.
- * 
+ *
  * Writes log messages to a file and optionally to stderr.
+ *
+ * Callers only format their line and push it onto a bounded lock-free queue
+ * (Vyukov's MPMC ring); a background thread drains the queue and writes each
+ * batch with a single write(). How eagerly that happens is the flush policy.
+ * Whatever is still queued is written synchronously at exit and, from the
+ * crash handler, by drainOnCrash().
+ *
+ * The writer also rotates the file (see LogRotator): the live log is retired
+ * once it reaches the size or age limit, counting what a previous run left in
+ * it. Only a rename happens on the writing thread; compression runs in the
+ * background. The live log is flock()ed by the process that rotates it; any
+ * other instance running at the same time appends to it but never rotates it.
  */
 class Logger {
 public:
+  /**
+   * @brief When queued lines reach the file.
+   */
+  enum class FlushPolicy {
+    Batch,    // The flusher wakes for new lines and writes all that accumulated (default)
+    Interval, // The flusher writes once per second, or when the queue is half full
+    Sync      // Each call writes its own line before returning; no queueing
+  };
+
   /**
    * @brief Access the singleton instance.
    */
   static Logger& instance();
-  
+
   /**
    * @brief Sets the path for the log file.
-   * 
+   *
+   * An existing log is continued, and retired right away only if it is already
+   * due. Set the rotation limits first.
+   *
    * @param path Path to the log file.
    */
   void setLogFile(const std::string& path);
 
+  /**
+   * @brief Sets the rotation limits (see LogRotator::configure()).
+   */
+  void setRotation(uint64_t maxBytes, std::chrono::seconds maxAge, unsigned int keep);
+
+  /**
+   * @brief Selects the flush policy (see FlushPolicy).
+   */
+  void setFlushPolicy(FlushPolicy policy);
+
+  /**
+   * @brief Parses a policy name: batch, interval or sync.
+   * @return false if the name is unknown.
+   */
+  static bool parseFlushPolicy(const std::string& name, FlushPolicy& out);
+
   /**
    * @brief Logs an informational message.
-   * 
-   * Thread-safe. Adds timestamp and [INFO] tag.
-   * 
+   *
+   * Thread-safe and lock-free. Adds timestamp and [INFO] tag.
+   *
    * @param message The message to log.
    */
   void log(const std::string& message);
 
   /**
    * @brief Logs an error message.
-   * 
-   * Thread-safe. Adds timestamp and [ERROR] tag. Also prints to stderr.
-   * 
+   *
+   * Thread-safe and lock-free. Adds timestamp and [ERROR] tag. Also prints to stderr.
+   *
    * @param message The error message to log.
    */
   void error(const std::string& message);
 
   /**
    * @brief Retrieves the current path of the log file.
-   * 
+   *
    * @return The path to the log file.
    */
   const std::string& getLogFilePath() const;
 
   /**
-   * @brief Closes the current log file stream.
-   * 
+   * @brief Writes out everything queued, then closes the current log file.
+   *
    * This is useful before attempting to rename the log file during a crash handling scenario.
    */
   void closeLogFile();
 
+  /**
+   * @brief Writes every queued line straight to the file. For signal handlers.
+   *
+   * Uses only atomics and write(); takes no lock and allocates nothing. Lines
+   * the flusher already took are written by the flusher itself.
+   */
+  void drainOnCrash();
+
 private:
-  Logger() = default;
+  static constexpr size_t QueueSize = 4096; // Power of two
+  static constexpr size_t MaxBatch = 64 * 1024; // Bytes per write()
+
+  struct Slot {
+    std::atomic<size_t> sequence;
+    std::string text;
+  };
+
+  Logger();
   ~Logger();
-  
+
   // Disable copying
   Logger(const Logger&) = delete;
   Logger& operator=(const Logger&) = delete;
 
-  std::ofstream m_file;
-  std::mutex m_mutex;
+  void enqueue(std::string line);
+  void flusher();
+  std::string formatLine(const char* level, const std::string& message) const;
+  void openLogLocked();
+  template <typename Consume> bool pop(Consume&& consume);
+  void retireLocked();
+  void wake();
+  void writeAll(int fd, const char* data, size_t size);
+  void writeLocked(const char* data, size_t size);
+
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(64) std::atomic<size_t> m_enqueuePos;
+  alignas(64) std::atomic<size_t> m_dequeuePos;
+  alignas(64) std::atomic<bool> m_sleeping;   // Flusher is (about to be) blocked in poll()
+  std::atomic<int> m_fd;                      // Log file, -1 = none
+  std::atomic<FlushPolicy> m_policy;
+  std::atomic<bool> m_stop;
+  std::mutex m_fileMutex;                     // Serializes writers and file changes; never taken by log()
   std::string m_logFilePath;
+  uint64_t m_fileSize;                        // Bytes in the live log (guarded by m_fileMutex)
+  std::chrono::steady_clock::time_point m_openedAt; // When the live log was created
+  bool m_ownsLog;                             // We hold its flock, so we may rotate it
+  LogRotator m_rotator;
+  int m_wakePipe[2];
+  std::thread m_thread;
 };
 
 // -----------------------------------------------------------------------------
 // Inline Implementations
 // -----------------------------------------------------------------------------
 
-inline Logger::~Logger() {
-  if (m_file.is_open()) {
-    m_file.close();
+inline Logger::Logger()
+    : m_slots(new Slot[QueueSize]), m_enqueuePos(0), m_dequeuePos(0), m_sleeping(false), m_fd(-1),
+      m_policy(FlushPolicy::Batch), m_stop(false), m_fileSize(0), m_ownsLog(false),
+      m_wakePipe{ -1, -1 } {
+  for (size_t i = 0; i < QueueSize; ++i) {
+    m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  if (pipe2(m_wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    m_policy = FlushPolicy::Sync; // No way to wake a flusher; write inline
+    std::cerr << "Logger: Failed to create wake pipe; logging synchronously." << std::endl;
+    return;
   }
+  m_thread = std::thread(&Logger::flusher, this);
+}
+
+inline Logger::~Logger() {
+  m_stop.store(true);
+  wake();
+  if (m_thread.joinable()) m_thread.join(); // The flusher drains the queue before it returns
+  closeLogFile();
+  if (m_wakePipe[0] >= 0) close(m_wakePipe[0]);
+  if (m_wakePipe[1] >= 0) close(m_wakePipe[1]);
 }
 
 inline Logger& Logger::instance() {
@@ -93,52 +201,213 @@ inline const std::string& Logger::getLogFilePath() const {
 }
 
 inline void Logger::closeLogFile() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if (m_file.is_open()) {
-        m_file.close();
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    int fd = m_fd.load();
+    if (fd >= 0) {
+        while (pop([&](const std::string& line) { writeAll(fd, line.data(), line.size()); })) {
+        }
+        m_fd.store(-1);
+        close(fd);
     }
 }
 
+inline void Logger::drainOnCrash() {
+  int fd = m_fd.load(std::memory_order_acquire);
+  while (pop([&](const std::string& line) {
+    if (fd >= 0) writeAll(fd, line.data(), line.size());
+  })) {
+  }
+}
+
+/**
+ * @brief Adds a line to the queue, or writes it right away under the Sync policy.
+ *
+ * A full queue means the flusher is far behind (or the disk stalls); the caller
+ * then yields until a slot frees up rather than losing the line.
+ */
+inline void Logger::enqueue(std::string line) {
+  if (m_policy.load(std::memory_order_relaxed) == FlushPolicy::Sync) {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    writeLocked(line.data(), line.size());
+    return;
+  }
+
+  size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &m_slots[pos & (QueueSize - 1)];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      wake(); // Full
+      std::this_thread::yield();
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    } else {
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  slot->text = std::move(line);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  // Interval policy: only a filling queue is worth a wake-up
+  if (m_policy.load(std::memory_order_relaxed) == FlushPolicy::Interval &&
+      pos - m_dequeuePos.load(std::memory_order_relaxed) < QueueSize / 2) {
+    return;
+  }
+  if (m_sleeping.exchange(false)) wake();
+}
+
 inline void Logger::error(const std::string& message) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  
-  auto now = std::chrono::system_clock::now();
-  auto time = std::chrono::system_clock::to_time_t(now);
-  auto tm = *std::localtime(&time);
-  
-  char timeBuffer[32];
-  std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &tm);
-
-  std::string formatted = std::format("[{}] [ERROR] {}", timeBuffer, message);
-  
-  if (m_file.is_open()) {
-    m_file << formatted << std::endl;
+  std::string formatted = formatLine("ERROR", message);
+  std::cerr << formatted; // Unbuffered, so it shows up right away
+  enqueue(std::move(formatted));
+}
+
+/**
+ * @brief Background thread: drains the queue in batches, one write() per batch.
+ */
+inline void Logger::flusher() {
+  pollfd pfd = { m_wakePipe[0], POLLIN, 0 };
+  std::string batch;
+  while (true) {
+    batch.clear();
+    // Bounded batches keep memory flat and let rotation happen close to the size limit
+    while (batch.size() < MaxBatch && pop([&](const std::string& line) { batch += line; })) {
+    }
+    if (!batch.empty()) {
+      std::lock_guard<std::mutex> lock(m_fileMutex);
+      writeLocked(batch.data(), batch.size());
+      continue; // More may have arrived meanwhile
+    }
+    if (m_stop.load()) return;
+
+    // Announce the sleep, then look once more so a line pushed in between is not stranded
+    m_sleeping.store(true);
+    if (m_enqueuePos.load() != m_dequeuePos.load()) {
+      m_sleeping.store(false);
+      continue;
+    }
+    int timeout = (m_policy.load(std::memory_order_relaxed) == FlushPolicy::Interval) ? 1000 : -1;
+    if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Keep going; don't spin
+    }
+    m_sleeping.store(false);
+    char drain[64];
+    while (read(m_wakePipe[0], drain, sizeof(drain)) > 0) {
+    }
   }
-  std::cerr << formatted << std::endl;
+}
+
+inline std::string Logger::formatLine(const char* level, const std::string& message) const {
+  char stamp[Timestamp::Length];
+  Timestamp::format(std::chrono::system_clock::now(), stamp);
+
+  // "[stamp] [LEVEL] message\n", assembled without a format string
+  std::string line;
+  line.reserve(Timestamp::Length + message.size() + 16);
+  line += '[';
+  line.append(stamp, Timestamp::Length);
+  line += "] [";
+  line += level;
+  line += "] ";
+  line += message;
+  line += '\n';
+  return line;
 }
 
 inline void Logger::log(const std::string& message) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  
-  auto now = std::chrono::system_clock::now();
-  auto time = std::chrono::system_clock::to_time_t(now);
-  auto tm = *std::localtime(&time);
-  
-  char timeBuffer[32];
-  std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &tm);
-
-  std::string formatted = std::format("[{}] [INFO] {}", timeBuffer, message);
-  
-  if (m_file.is_open()) {
-    m_file << formatted << std::endl;
+  enqueue(formatLine("INFO", message));
+}
+
+inline bool Logger::parseFlushPolicy(const std::string& name, FlushPolicy& out) {
+  if (name == "batch") out = FlushPolicy::Batch;
+  else if (name == "interval") out = FlushPolicy::Interval;
+  else if (name == "sync") out = FlushPolicy::Sync;
+  else return false;
+  return true;
+}
+
+/**
+ * @brief Takes the oldest queued line, if any, and hands it to consume.
+ *
+ * Safe from several consumers at once (the flusher and a crash handler).
+ */
+template <typename Consume>
+inline bool Logger::pop(Consume&& consume) {
+  size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &m_slots[pos & (QueueSize - 1)];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return false; // Empty
+    } else {
+      pos = m_dequeuePos.load(std::memory_order_relaxed);
+    }
   }
+  consume(slot->text);
+  slot->sequence.store(pos + QueueSize, std::memory_order_release);
+  return true;
 }
 
-inline void Logger::setLogFile(const std::string& path) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  if (m_file.is_open()) {
-    m_file.close();
+/**
+ * @brief Opens m_logFilePath for appending and tries to become its owner. Caller holds m_fileMutex.
+ *
+ * Size and age start from the file as found, so a continued log is retired on schedule.
+ */
+inline void Logger::openLogLocked() {
+  int fd = open(m_logFilePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "Failed to open log file: " << m_logFilePath << std::endl;
   }
+  m_ownsLog = fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0; // Released when the fd is closed
+  m_fileSize = 0;
+  m_openedAt = std::chrono::steady_clock::now();
+
+  struct statx st;
+  if (fd >= 0 && statx(fd, "", AT_EMPTY_PATH, STATX_SIZE | STATX_BTIME, &st) == 0) {
+    m_fileSize = st.stx_size;
+    if (st.stx_mask & STATX_BTIME) {
+      auto age = std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(st.stx_btime.tv_sec);
+      if (age > std::chrono::seconds(0)) {
+        m_openedAt -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+      }
+    }
+  }
+  m_fd.store(fd, std::memory_order_release);
+}
+
+/**
+ * @brief Turns the live log into a generation and starts a new one. Caller holds m_fileMutex and owns the log.
+ */
+inline void Logger::retireLocked() {
+  int fd = m_fd.load(std::memory_order_relaxed);
+  m_fd.store(-1, std::memory_order_release);
+  if (fd >= 0) close(fd);
+  m_rotator.retire(m_logFilePath);
+  openLogLocked();
+}
+
+inline void Logger::setFlushPolicy(FlushPolicy policy) {
+  if (m_wakePipe[0] < 0) return; // Stuck with Sync
+  if (policy == FlushPolicy::Sync) {
+    // Lines queued before the switch must still come first
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    while (pop([&](const std::string& line) { writeLocked(line.data(), line.size()); })) {
+    }
+  }
+  m_policy.store(policy);
+  wake();
+}
+
+inline void Logger::setLogFile(const std::string& path) {
+  closeLogFile();
+  std::lock_guard<std::mutex> lock(m_fileMutex);
   m_logFilePath = path;
 
   // Create directory if it doesn't exist
@@ -147,9 +416,49 @@ inline void Logger::setLogFile(const std::string& path) {
     std::filesystem::create_directories(logPath.parent_path());
   }
 
-  m_file.open(path, std::ios::out | std::ios::trunc); // Overwrite mode
-  if (!m_file.is_open()) {
-    std::cerr << "Failed to open log file: " << path << std::endl;
+  // A previous run's log is continued; only one already past its limits is retired now
+  openLogLocked();
+  if (m_ownsLog && m_rotator.due(m_fileSize, m_openedAt)) {
+    retireLocked();
+  }
+}
+
+inline void Logger::setRotation(uint64_t maxBytes, std::chrono::seconds maxAge, unsigned int keep) {
+  m_rotator.configure(maxBytes, maxAge, keep);
+}
+
+inline void Logger::wake() {
+  if (m_wakePipe[1] < 0) return;
+  char wake = 1;
+  ssize_t written = write(m_wakePipe[1], &wake, 1); // A full pipe already holds a wake-up
+  (void)written;
+}
+
+/**
+ * @brief write() until everything is out; gives up on errors other than EINTR.
+ */
+inline void Logger::writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    data += n;
+    size -= (size_t)n;
+  }
+}
+
+/**
+ * @brief Writes to the live log and retires it once it is due. Caller holds m_fileMutex.
+ */
+inline void Logger::writeLocked(const char* data, size_t size) {
+  int fd = m_fd.load(std::memory_order_relaxed);
+  if (fd < 0) return;
+  writeAll(fd, data, size);
+  m_fileSize += size;
+  if (m_ownsLog && m_rotator.due(m_fileSize, m_openedAt)) {
+    retireLocked();
   }
 }
 
@@ -0,0 +1,322 @@
+#ifndef VOICECLI_SRC_METRICS_HPP
+#define VOICECLI_SRC_METRICS_HPP
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Session latency histograms and event counters, served in Prometheus text format.
+ *
+ * Histograms are log-linear in the style of HdrHistogram: each power of two is
+ * split into four buckets, so any recorded value lands in a bucket at most 25%
+ * wider than the value itself, over a range of 1 µs to about 70 minutes.
+ * Recording is a handful of relaxed atomic additions (wait-free, no locks, no
+ * allocation), so it can sit on the session paths without affecting them.
+ *
+ * serve() exposes everything on a Unix socket or a loopback TCP port. Each
+ * connection gets one snapshot and is closed; an HTTP GET (as sent by Prometheus
+ * or `curl --unix-socket`) is answered with an HTTP response, anything else
+ * with the bare text.
+ */
+class Metrics {
+public:
+  enum class Histogram { TriggerToRecord, StopToText, TextToPaste, RealTimeFactor, Count };
+  enum class Counter { Sessions, Aborts, VadPauses, OverrunFrames, Count };
+
+  /**
+   * @brief Access the singleton instance.
+   */
+  static Metrics& instance();
+
+  /**
+   * @brief Adds n to a counter.
+   */
+  void add(Counter counter, uint64_t n = 1);
+
+  /**
+   * @brief Records a latency.
+   */
+  void observe(Histogram histogram, std::chrono::steady_clock::duration latency);
+
+  /**
+   * @brief Records a value in the histogram's base unit (seconds, or a plain ratio).
+   */
+  void observe(Histogram histogram, double value);
+
+  /**
+   * @brief Renders all metrics in the Prometheus text exposition format.
+   */
+  std::string render() const;
+
+  /**
+   * @brief Starts serving the metrics.
+   * @param endpoint A Unix socket path, or a port number to listen on at 127.0.0.1.
+   * @throws std::runtime_error If the socket cannot be created.
+   */
+  void serve(const std::string& endpoint);
+
+private:
+  static constexpr int SubBits = 2;                      // 4 buckets per power of two
+  static constexpr int MaxExponent = 32;                 // Values up to 2^32 units
+  static constexpr size_t Buckets = (MaxExponent - 1) << SubBits; // Plus one overflow bucket
+
+  struct Series {
+    const char* name;
+    const char* help;
+    double scale; // Recorded units per base unit
+    std::atomic<uint64_t> buckets[Buckets + 1];
+    std::atomic<uint64_t> sum; // In recorded units
+  };
+
+  Metrics();
+  ~Metrics();
+
+  // Disable copying
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  static size_t bucketOf(uint64_t value);
+  static uint64_t upperBound(size_t bucket);
+  void reply(int fd) const;
+  void serverLoop();
+
+  Series m_histograms[(size_t)Histogram::Count];
+  std::atomic<uint64_t> m_counters[(size_t)Counter::Count];
+  std::string m_socketPath; // Unlinked on exit; empty when serving TCP
+  int m_listenFd;
+  int m_wakePipe[2];
+  std::atomic<bool> m_stop;
+  std::thread m_thread;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline Metrics::Metrics()
+    : m_histograms{ { "voicecli_trigger_to_record_seconds", "Time from trigger to the recorder running.", 1e6, {}, {} },
+                    { "voicecli_stop_to_text_seconds", "Time from stopping a recording to its transcription.", 1e6, {}, {} },
+                    { "voicecli_text_to_paste_seconds", "Time from transcription to the text being pasted.", 1e6, {}, {} },
+                    { "voicecli_inference_real_time_factor", "Inference time divided by audio duration.", 1e3, {}, {} } },
+      m_counters{}, m_listenFd(-1), m_wakePipe{ -1, -1 }, m_stop(false) {
+}
+
+inline Metrics::~Metrics() {
+  m_stop.store(true);
+  if (m_wakePipe[1] >= 0) {
+    char wake = 0;
+    ssize_t written = write(m_wakePipe[1], &wake, 1);
+    (void)written;
+  }
+  if (m_thread.joinable()) m_thread.join();
+  if (m_listenFd >= 0) {
+    close(m_listenFd);
+    if (!m_socketPath.empty()) unlink(m_socketPath.c_str());
+  }
+  for (int fd : m_wakePipe) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+inline void Metrics::add(Counter counter, uint64_t n) {
+  m_counters[(size_t)counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Bucket of a value: the exponent picks the power of two, the next SubBits bits the bucket within it.
+ */
+inline size_t Metrics::bucketOf(uint64_t value) {
+  if (value < (1u << SubBits)) return (size_t)value;
+  int exponent = std::bit_width(value) - 1;
+  if (exponent >= MaxExponent) return Buckets;
+  size_t sub = (size_t)(value >> (exponent - SubBits)) & ((1u << SubBits) - 1);
+  return ((size_t)(exponent - SubBits + 1) << SubBits) + sub;
+}
+
+inline Metrics& Metrics::instance() {
+  static Metrics instance;
+  return instance;
+}
+
+inline void Metrics::observe(Histogram histogram, std::chrono::steady_clock::duration latency) {
+  observe(histogram, std::chrono::duration<double>(latency).count());
+}
+
+inline void Metrics::observe(Histogram histogram, double value) {
+  Series& series = m_histograms[(size_t)histogram];
+  double scaled = std::round(value * series.scale);
+  uint64_t units = scaled > 0 ? (scaled < 1.8e19 ? (uint64_t)scaled : UINT64_MAX) : 0;
+  series.buckets[bucketOf(units)].fetch_add(1, std::memory_order_relaxed);
+  series.sum.fetch_add(units, std::memory_order_relaxed);
+}
+
+inline std::string Metrics::render() const {
+  std::string out;
+  for (const Series& series : m_histograms) {
+    out += std::format("# HELP {} {}\n# TYPE {} histogram\n", series.name, series.help, series.name);
+    // _count is the bucket total, so it always matches the +Inf bucket of the same scrape
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < Buckets; ++i) {
+      cumulative += series.buckets[i].load(std::memory_order_relaxed);
+      out += std::format("{}_bucket{{le=\"{}\"}} {}\n", series.name, upperBound(i) / series.scale, cumulative);
+    }
+    cumulative += series.buckets[Buckets].load(std::memory_order_relaxed);
+    out += std::format("{}_bucket{{le=\"+Inf\"}} {}\n", series.name, cumulative);
+    out += std::format("{}_sum {}\n", series.name, series.sum.load(std::memory_order_relaxed) / series.scale);
+    out += std::format("{}_count {}\n", series.name, cumulative);
+  }
+
+  static const char* const counters[][2] = {
+    { "voicecli_sessions_total", "Recording sessions started." },
+    { "voicecli_aborts_total", "Recording sessions aborted by the user." },
+    { "voicecli_vad_pauses_total", "Automatic pauses after silence." },
+    { "voicecli_audio_overrun_frames_total", "Audio frames lost to capture ring overruns." },
+  };
+  for (size_t i = 0; i < (size_t)Counter::Count; ++i) {
+    out += std::format("# HELP {} {}\n# TYPE {} counter\n{} {}\n", counters[i][0], counters[i][1], counters[i][0],
+                       counters[i][0], m_counters[i].load(std::memory_order_relaxed));
+  }
+  return out;
+}
+
+/**
+ * @brief Answers one client: waits briefly for a request, then writes a snapshot.
+ */
+inline void Metrics::reply(int fd) const {
+  // Read the request head if one comes; a bare reader sends nothing and gets plain text
+  std::string request;
+  char buffer[1024];
+  pollfd pfd = { fd, POLLIN, 0 };
+  while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos && poll(&pfd, 1, 200) > 0) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) break;
+    request.append(buffer, (size_t)n);
+  }
+
+  std::string body = render();
+  std::string data = body;
+  if (request.starts_with("GET ")) {
+    data = std::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\n"
+                       "Connection: close\r\n\r\n",
+                       body.size()) + body;
+  }
+
+  timeval timeout = { 1, 0 }; // Don't let a stalled client hold up the next scrape
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += (size_t)n;
+  }
+}
+
+inline void Metrics::serve(const std::string& endpoint) {
+  if (m_listenFd >= 0) return;
+
+  bool isPort = !endpoint.empty() && endpoint.find_first_not_of("0123456789") == std::string::npos;
+  if (isPort) {
+    unsigned long port = std::stoul(endpoint);
+    if (port < 1 || port > 65535) {
+      throw std::runtime_error("Invalid metrics port: " + endpoint);
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+      throw std::runtime_error("Failed to create metrics socket.");
+    }
+    int reuse = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 4) != 0) {
+      std::string err = std::strerror(errno);
+      close(m_listenFd);
+      m_listenFd = -1;
+      throw std::runtime_error("Failed to listen on metrics port " + endpoint + ": " + err);
+    }
+  } else {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(addr.sun_path)) {
+      throw std::runtime_error("Metrics socket path is too long: " + endpoint);
+    }
+    std::strncpy(addr.sun_path, endpoint.c_str(), sizeof(addr.sun_path) - 1);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+      throw std::runtime_error("Failed to create metrics socket.");
+    }
+    unlink(endpoint.c_str()); // Remove a stale socket from a previous run
+    if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 4) != 0) {
+      std::string err = std::strerror(errno);
+      close(m_listenFd);
+      m_listenFd = -1;
+      throw std::runtime_error("Failed to listen on metrics socket " + endpoint + ": " + err);
+    }
+    m_socketPath = endpoint;
+  }
+
+  if (pipe2(m_wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    throw std::runtime_error("Failed to create metrics wake pipe.");
+  }
+  m_thread = std::thread(&Metrics::serverLoop, this);
+  Logger::instance().log(isPort ? "Metrics: Serving on 127.0.0.1:" + endpoint
+                                : "Metrics: Serving on Unix socket " + endpoint);
+}
+
+/**
+ * @brief Server thread: answers connections one at a time until the wake pipe fires.
+ */
+inline void Metrics::serverLoop() {
+  pollfd pfds[2] = { { m_listenFd, POLLIN, 0 }, { m_wakePipe[0], POLLIN, 0 } };
+  while (!m_stop.load()) {
+    if (poll(pfds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      Logger::instance().error(std::format("Metrics: poll failed: {}", std::strerror(errno)));
+      return;
+    }
+    if (pfds[1].revents) return;
+    if (!(pfds[0].revents & POLLIN)) continue;
+
+    int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) continue;
+    reply(fd);
+    close(fd);
+  }
+}
+
+/**
+ * @brief Inclusive upper bound of a bucket, in recorded units.
+ */
+inline uint64_t Metrics::upperBound(size_t bucket) {
+  if (bucket < (1u << SubBits)) return bucket;
+  size_t exponent = (bucket >> SubBits) + SubBits - 1;
+  size_t sub = bucket & ((1u << SubBits) - 1);
+  return ((((1ull << SubBits) + sub + 1) << (exponent - SubBits)) - 1);
+}
+
+#endif // VOICECLI_SRC_METRICS_HPP
@@ -0,0 +1,193 @@
+#ifndef VOICECLI_SRC_PASTESTRATEGYCACHE_HPP
+#define VOICECLI_SRC_PASTESTRATEGYCACHE_HPP
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "Logger.hpp"
+
+/**
+ * @brief How text gets into a target application.
+ */
+enum class PasteStrategy {
+  CtrlV,      // CLIPBOARD + Ctrl+V
+  CtrlShiftV, // CLIPBOARD + Ctrl+Shift+V (terminals)
+  Typed,      // Synthetic key events, no selection
+  Primary     // PRIMARY + Shift+Insert
+};
+
+/**
+ * @brief Remembers which paste strategy works for which application.
+ *
+ * Applications are identified by the class part of WM_CLASS (e.g.
+ * "XTerm", "firefox"). The table is kept in a text file with one
+ * `class = strategy` line per application; blank lines and lines starting with
+ * '#' are ignored. Strategy names are ctrl-v, ctrl-shift-v, typed and primary.
+ *
+ * Resolving a window's class costs round trips (the focus is often a child of
+ * the window carrying WM_CLASS), so results are cached per window id.
+ */
+class PasteStrategyCache {
+public:
+  /**
+   * @brief Loads the table.
+   * @param display Connection used for WM_CLASS lookups; must outlive the cache.
+   * @param path The table file (empty = keep the table in memory only). A missing file is an empty table.
+   */
+  PasteStrategyCache(Display* display, const std::string& path);
+
+  /**
+   * @brief Returns the application class of a window, walking up to the toplevel if needed.
+   * @return The class, or an empty string if no ancestor has WM_CLASS.
+   */
+  const std::string& appClass(Window window);
+
+  /**
+   * @brief Records the strategy that worked for an application and saves the table if it changed.
+   */
+  void learn(const std::string& app, PasteStrategy strategy);
+
+  /**
+   * @brief Returns the learned strategy for an application, if any.
+   */
+  std::optional<PasteStrategy> lookup(const std::string& app) const;
+
+  /**
+   * @brief Returns the table name of a strategy.
+   */
+  static const char* name(PasteStrategy strategy);
+
+private:
+  static std::optional<PasteStrategy> parse(const std::string& name);
+
+  void save() const;
+
+  Display* m_display;
+  std::string m_path;
+  std::map<std::string, PasteStrategy> m_table;       // Sorted, so the file diffs cleanly
+  std::unordered_map<Window, std::string> m_classes;  // Window id -> application class
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline PasteStrategyCache::PasteStrategyCache(Display* display, const std::string& path)
+    : m_display(display), m_path(path) {
+  if (m_path.empty()) return;
+  std::ifstream file(m_path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    auto eq = line.rfind('=');
+    if (eq == std::string::npos) continue;
+    auto trim = [](std::string s) {
+      s.erase(0, s.find_first_not_of(" \t"));
+      s.erase(s.find_last_not_of(" \t\r") + 1);
+      return s;
+    };
+    std::string app = trim(line.substr(0, eq));
+    auto strategy = parse(trim(line.substr(eq + 1)));
+    if (!app.empty() && strategy) {
+      m_table[app] = *strategy;
+    } else {
+      Logger::instance().error(std::format("PasteStrategy: Ignoring line '{}' in {}.", line, m_path));
+    }
+  }
+  if (!m_table.empty()) {
+    Logger::instance().log(std::format("PasteStrategy: {} application(s) loaded from {}.", m_table.size(), m_path));
+  }
+}
+
+inline const std::string& PasteStrategyCache::appClass(Window window) {
+  auto cached = m_classes.find(window);
+  if (cached != m_classes.end()) return cached->second;
+  if (m_classes.size() >= 256) m_classes.clear(); // Window ids of closed windows pile up otherwise
+
+  std::string app;
+  Window current = window;
+  for (int depth = 0; current != 0 && current != PointerRoot && depth < 16; ++depth) {
+    XClassHint hint = { nullptr, nullptr };
+    if (XGetClassHint(m_display, current, &hint)) {
+      if (hint.res_class) app = hint.res_class;
+      if (hint.res_name) XFree(hint.res_name);
+      if (hint.res_class) XFree(hint.res_class);
+      if (!app.empty()) break;
+    }
+
+    Window root, parent;
+    Window* children = nullptr;
+    unsigned int count = 0;
+    if (!XQueryTree(m_display, current, &root, &parent, &children, &count)) break;
+    if (children) XFree(children);
+    if (parent == root) break;
+    current = parent;
+  }
+  return m_classes.emplace(window, app).first->second;
+}
+
+inline void PasteStrategyCache::learn(const std::string& app, PasteStrategy strategy) {
+  if (app.empty()) return;
+  auto it = m_table.find(app);
+  if (it != m_table.end() && it->second == strategy) return;
+
+  m_table[app] = strategy;
+  Logger::instance().log(std::format("PasteStrategy: '{}' uses {}.", app, name(strategy)));
+  save();
+}
+
+inline std::optional<PasteStrategy> PasteStrategyCache::lookup(const std::string& app) const {
+  auto it = m_table.find(app);
+  if (it == m_table.end()) return std::nullopt;
+  return it->second;
+}
+
+inline const char* PasteStrategyCache::name(PasteStrategy strategy) {
+  switch (strategy) {
+  case PasteStrategy::CtrlV: return "ctrl-v";
+  case PasteStrategy::CtrlShiftV: return "ctrl-shift-v";
+  case PasteStrategy::Typed: return "typed";
+  case PasteStrategy::Primary: return "primary";
+  }
+  return "ctrl-v";
+}
+
+inline std::optional<PasteStrategy> PasteStrategyCache::parse(const std::string& name) {
+  if (name == "ctrl-v") return PasteStrategy::CtrlV;
+  if (name == "ctrl-shift-v") return PasteStrategy::CtrlShiftV;
+  if (name == "typed") return PasteStrategy::Typed;
+  if (name == "primary") return PasteStrategy::Primary;
+  return std::nullopt;
+}
+
+inline void PasteStrategyCache::save() const {
+  if (m_path.empty()) return;
+  // Write a sibling file and rename it over the table, so a crash never leaves half a table
+  std::string temp = m_path + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::trunc);
+    if (!file) {
+      Logger::instance().error(std::format("PasteStrategy: Cannot write {}.", temp));
+      return;
+    }
+    file << "# Paste strategy per application (WM_CLASS), learned by VoiceCLI.\n"
+         << "# Strategies: ctrl-v, ctrl-shift-v, typed, primary\n";
+    for (const auto& [app, strategy] : m_table) {
+      file << app << " = " << name(strategy) << "\n";
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(temp, m_path, ec);
+  if (ec) {
+    Logger::instance().error(std::format("PasteStrategy: Cannot replace {}: {}", m_path, ec.message()));
+  }
+}
+
+#endif // VOICECLI_SRC_PASTESTRATEGYCACHE_HPP
@@ -2,6 +2,7 @@
 #define VOICECLI_SRC_PASTER_HPP
 
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/XTest.h>
 #include <string>
@@ -9,20 +10,53 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <format>
+#include <memory>
+#include <poll.h>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+#include "KeyTyper.hpp"
+#include "Logger.hpp"
+#include "PasteStrategyCache.hpp"
+#include "Trace.hpp"
+#include "X11Connection.hpp"
 
 /**
  * @brief Handles text pasting into external applications using X11.
- * 
+ *
  * Simulates Ctrl+V (or Ctrl+Shift+V) and manages the X11 CLIPBOARD selection
- * to transfer text to the focused window.
+ * to transfer text to the focused window. Text larger than one request is sent
+ * with the ICCCM INCR protocol in chunks sized to the server's request limit.
+ *
+ * The user's clipboard survives a paste: before taking ownership, every target
+ * of up to 64 KiB the previous owner offers is converted into a property on our
+ * hidden window, so the data stays in the X server rather than in this process;
+ * larger ones (images, say) are not worth delaying the paste for. Once the paste
+ * has been served, a background thread answers CLIPBOARD requests from those
+ * properties, reading them in chunks only when somebody asks, until another
+ * client takes the selection.
+ *
+ * Which shortcut works depends on the application. The strategy whose shortcut
+ * made an application fetch the text is remembered under its WM_CLASS and used
+ * for it from then on. Only requests from the target's own X client count, so a
+ * clipboard manager reading every new selection does not fake a success.
  */
 class Paster {
 public:
   /**
-   * @brief Initializes connection to the X server and creates a dummy window for selection ownership.
+   * @brief Attaches to the shared paste connection and creates a dummy window for selection ownership.
+   *
+   * Meant to live for the whole daemon run, so pasting costs no connection setup.
+   *
+   * @param strategyFile Where learned per-application strategies are kept (empty = not persisted).
    * @throws std::runtime_error If X display cannot be opened.
    */
-  Paster();
+  explicit Paster(const std::string& strategyFile = "");
   ~Paster();
 
   // Disable copying
@@ -30,148 +64,905 @@ public:
   Paster& operator=(const Paster&) = delete;
 
   /**
-   * @brief Copies text to the clipboard and simulates a paste keystroke.
-   * 
-   * This function takes ownership of the X11 CLIPBOARD selection, simulates
-   * the paste shortcut key press, and then handles the resulting SelectionRequest
-   * events from the target application to transfer the data.
-   * 
+   * @brief Copies text to a selection and simulates a paste keystroke.
+   *
+   * This function takes ownership of the X11 CLIPBOARD (or PRIMARY) selection, restores
+   * focus to the target, simulates the paste shortcut key press, and then handles the
+   * resulting SelectionRequest events from the target application to transfer the data.
+   *
+   * If the target's application has a learned strategy, that one is used instead of
+   * @p strategy. For a known application, a strategy whose shortcut the target is known
+   * to have ignored (it answered a _NET_WM_PING sent after the keys without asking for
+   * the text) is followed by the others in turn, ending with typing, and the first one
+   * the target fetches the text with is learned. All attempts share one 2 s deadline.
+   * When the target does not answer in time the chain stops, since the keys may still
+   * arrive: the text stays on the clipboard for them instead of the user's old contents.
+   *
    * @param text The text to paste.
    * @param targetWindow The window ID to restore focus to before pasting (optional).
-   * @param useShift If true, simulates Ctrl+Shift+V (often used in terminals).
+   * @param strategy The strategy to use for applications with nothing learned yet.
    * @param verbose If true, prints debug info.
    */
-  void paste(const std::string& text, Window targetWindow = 0, bool useShift = false, bool verbose = false);
+  void paste(const std::string& text, Window targetWindow = 0, PasteStrategy strategy = PasteStrategy::CtrlV,
+             bool verbose = false);
+
+  /**
+   * @brief Resolves the target's application class ahead of the paste.
+   *
+   * Call when the target is captured, so the lookup's round trips happen while
+   * the user is still talking.
+   */
+  void prepare(Window targetWindow);
+
+  /**
+   * @brief Types text as key events instead of going through the clipboard.
+   *
+   * For targets that ignore pastes. The clipboard is left untouched.
+   *
+   * @param text The text to type.
+   * @param targetWindow The window ID to restore focus to before typing (optional).
+   * @param verbose If true, prints debug info.
+   */
+  void type(const std::string& text, Window targetWindow = 0, bool verbose = false);
 
 private:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief What a selection paste attempt found out about its shortcut.
+   */
+  enum class Outcome {
+    Delivered, // The target fetched the text
+    Requested, // The target asked, but the transfer did not complete
+    Ignored,   // The target processed the keys without asking
+    Unanswered // Nothing known; the keys may still be on their way
+  };
+
+  /**
+   * @brief An INCR transfer in progress: the requestor deletes the property, we write the next chunk.
+   *
+   * The source is either text in memory or a saved property on our window.
+   */
+  struct IncrTransfer {
+    Window requestor;
+    Atom property;
+    Atom type;
+    int format;
+    std::string_view data; // In-memory source (storage == None)
+    Atom storage;          // Saved-property source
+    size_t offset;         // Bytes sent so far
+    size_t total;
+  };
+
+  /**
+   * @brief One target of the previous clipboard owner, held server-side.
+   */
+  struct SavedTarget {
+    Atom target;
+    Atom type;
+    int format;
+    Atom storage; // Property on m_window holding the data
+    size_t bytes;
+  };
+
+  bool advanceTransfer(const XPropertyEvent& ev, bool verbose);
+  void clearSnapshot();
+  void handBack(const std::string& text, Window targetWindow, bool keepText);
+  bool nextEvent(XEvent& e, Clock::time_point deadline);
+  Outcome pasteSelection(const std::string& text, Window targetWindow, PasteStrategy strategy,
+                         Clock::time_point deadline, bool verbose);
+  long pingTarget(Window targetWindow);
+  bool restoreFocus(Window targetWindow, bool verbose);
+  bool sameClient(Window a, Window b) const;
+  void sendShortcut(PasteStrategy strategy);
+  void serveLoop();
+  bool serveRequest(const XSelectionRequestEvent& req, const std::string& text, bool verbose);
+  void serveSaved(const XSelectionRequestEvent& req);
+  void snapshotClipboard();
+  void startServing();
+  void stopServing();
+  void typeText(const std::string& text, Window targetWindow, bool verbose);
+
   Display* m_display;
   Window m_window;
+  size_t m_chunkSize; // Largest property write that fits in one request
+  std::vector<IncrTransfer> m_transfers;
+  std::vector<SavedTarget> m_saved;
+  Atom m_clipboard;
+  Atom m_targets;
+  Atom m_incr;
+  Atom m_wmProtocols;
+  Atom m_wmPing;
+  XID m_resourceMask;        // Low XID bits a client allocates; the rest identify the client
+  long m_pingStamp;
+  std::string m_lateText;    // Served to the target after an unanswered attempt, until fetched once
+  Window m_lateTarget;
+  std::thread m_serveThread; // Owns m_display while running
+  int m_wakePipe[2];
+  std::unique_ptr<KeyTyper> m_typer; // Created on first use
+  PasteStrategyCache m_strategies;
 };
 
 // -----------------------------------------------------------------------------
 // Inline Implementations
 // -----------------------------------------------------------------------------
 
-inline Paster::Paster() : m_display(nullptr) {
-  m_display = XOpenDisplay(NULL);
-  if (!m_display) {
-    throw std::runtime_error("Failed to open X Display for Paster.");
+// WM_CLASS lookups go through the input connection: the paste connection may
+// belong to the clipboard thread when prepare() is called.
+inline Paster::Paster(const std::string& strategyFile)
+    : m_display(nullptr), m_chunkSize(0), m_pingStamp(0), m_lateTarget(0),
+      m_strategies(X11Connection::instance().display(X11Connection::Channel::Input), strategyFile) {
+  X11Connection& x11 = X11Connection::instance();
+  m_display = x11.display(X11Connection::Channel::Paste);
+
+  // Request sizes are in 4-byte units; leave room for the ChangeProperty header.
+  // Chunks stay a multiple of 4 so saved properties can be read back by 32-bit offset.
+  long maxRequest = XExtendedMaxRequestSize(m_display);
+  if (maxRequest == 0) maxRequest = XMaxRequestSize(m_display);
+  m_chunkSize = std::clamp<size_t>((size_t)maxRequest * 4 - 64, 4096, 256 * 1024) & ~(size_t)3;
+
+  // The serve thread must not intern atoms, so look these up now
+  m_clipboard = x11.atom("CLIPBOARD");
+  m_targets = x11.atom("TARGETS");
+  m_incr = x11.atom("INCR");
+  m_wmProtocols = x11.atom("WM_PROTOCOLS");
+  m_wmPing = x11.atom("_NET_WM_PING");
+
+  // Xlib runs on XCB, whose connection setup carries the mask
+  m_resourceMask = xcb_get_setup(XGetXCBConnection(m_display))->resource_id_mask;
+
+  if (pipe2(m_wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    throw std::runtime_error("Failed to create Paster wake pipe.");
   }
-  // Create an invisible window to own the selection
-  m_window = XCreateSimpleWindow(m_display, DefaultRootWindow(m_display), 
+
+  // Create an invisible window to own the selection; property events carry incoming INCR data
+  m_window = XCreateSimpleWindow(m_display, DefaultRootWindow(m_display),
                                  0, 0, 1, 1, 0, 0, 0);
+  XSelectInput(m_display, m_window, PropertyChangeMask);
 }
 
 inline Paster::~Paster() {
+  stopServing();
+  m_typer.reset();
   if (m_display) {
+    clearSnapshot();
     XDestroyWindow(m_display, m_window);
-    XCloseDisplay(m_display);
+    XFlush(m_display);
+  }
+  close(m_wakePipe[0]);
+  close(m_wakePipe[1]);
+}
+
+/**
+ * @brief Sends the next INCR chunk after the requestor deleted the previous one.
+ *
+ * A zero-length write after the last chunk ends the transfer.
+ *
+ * @return true if this event completed a transfer.
+ */
+inline bool Paster::advanceTransfer(const XPropertyEvent& ev, bool verbose) {
+  if (ev.state != PropertyDelete) return false;
+
+  for (auto it = m_transfers.begin(); it != m_transfers.end(); ++it) {
+    if (it->requestor != ev.window || it->property != ev.atom) continue;
+
+    size_t len = 0;
+    if (it->offset >= it->total) {
+      XChangeProperty(m_display, it->requestor, it->property, it->type, it->format, PropModeReplace, nullptr, 0);
+    } else if (it->storage == None) {
+      len = std::min(m_chunkSize, it->total - it->offset);
+      XChangeProperty(m_display, it->requestor, it->property, it->type, 8, PropModeReplace,
+                      (const unsigned char*)it->data.data() + it->offset, (int)len);
+    } else {
+      // Only this chunk of the saved data ever enters our memory
+      Atom type;
+      int format;
+      unsigned long items, after;
+      unsigned char* chunk = nullptr;
+      if (XGetWindowProperty(m_display, m_window, it->storage, it->offset / 4, m_chunkSize / 4, False,
+                             AnyPropertyType, &type, &format, &items, &after, &chunk) == Success && chunk) {
+        XChangeProperty(m_display, it->requestor, it->property, it->type, it->format, PropModeReplace,
+                        chunk, (int)items);
+        len = items * format / 8;
+        XFree(chunk);
+      }
+      if (len == 0) it->total = it->offset; // Storage vanished; end the transfer cleanly
+    }
+    it->offset += len;
+    XFlush(m_display);
+
+    if (len == 0 && it->offset >= it->total) {
+      if (verbose) std::cout << "Paster: INCR transfer complete." << std::endl;
+      XSelectInput(m_display, it->requestor, NoEventMask);
+      m_transfers.erase(it);
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+/**
+ * @brief Deletes the saved clipboard properties.
+ */
+inline void Paster::clearSnapshot() {
+  for (const auto& saved : m_saved) {
+    XDeleteProperty(m_display, m_window, saved.storage);
   }
+  m_saved.clear();
 }
 
-inline void Paster::paste(const std::string& text, Window targetWindow, bool useShift, bool verbose) {
+/**
+ * @brief Lets go of the selections after a paste attempt and hands the clipboard to the serve thread.
+ *
+ * @param keepText Keep answering the target with the text: its shortcut may still arrive.
+ */
+inline void Paster::handBack(const std::string& text, Window targetWindow, bool keepText) {
+  if (keepText) {
+    m_lateText = text;
+    m_lateTarget = targetWindow;
+  } else {
+    if (XGetSelectionOwner(m_display, XA_PRIMARY) == m_window) {
+      XSetSelectionOwner(m_display, XA_PRIMARY, None, CurrentTime);
+    }
+    if (m_saved.empty() && XGetSelectionOwner(m_display, m_clipboard) == m_window) {
+      XSetSelectionOwner(m_display, m_clipboard, None, CurrentTime);
+    }
+  }
+  XFlush(m_display);
+  if (!m_saved.empty() || !m_lateText.empty()) startServing();
+}
+
+/**
+ * @brief Waits for the next event on the paste connection.
+ *
+ * Sleeps in poll() on the connection's socket instead of sampling the queue.
+ *
+ * @return false if the deadline passed first.
+ */
+inline bool Paster::nextEvent(XEvent& e, Clock::time_point deadline) {
+  while (XPending(m_display) == 0) {
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+    if (left.count() <= 0) return false;
+
+    pollfd pfd = { ConnectionNumber(m_display), POLLIN, 0 };
+    if (poll(&pfd, 1, (int)left.count()) <= 0) return false;
+  }
+  XNextEvent(m_display, &e);
+  return true;
+}
+
+inline void Paster::paste(const std::string& text, Window targetWindow, PasteStrategy strategy, bool verbose) {
   if (text.empty()) return;
+  TRACE_SCOPE("Paster::paste");
+
+  const std::string app = (targetWindow != 0) ? m_strategies.appClass(targetWindow) : "";
+  auto learned = m_strategies.lookup(app);
+  if (learned) strategy = *learned;
+
+  // Only a known application is worth probing: the result is remembered for it
+  std::vector<PasteStrategy> order = { strategy };
+  if (!app.empty()) {
+    for (PasteStrategy next : { PasteStrategy::CtrlV, PasteStrategy::CtrlShiftV, PasteStrategy::Primary,
+                                PasteStrategy::Typed }) {
+      if (next != strategy) order.push_back(next);
+    }
+  }
+
+  auto deadline = Clock::now() + std::chrono::seconds(2); // For the whole chain
+  for (PasteStrategy attempt : order) {
+    if (verbose) {
+      std::cout << "Paster: Pasting into '" << app << "' with " << PasteStrategyCache::name(attempt) << "." << std::endl;
+    }
+    if (attempt == PasteStrategy::Typed) {
+      typeText(text, targetWindow, verbose); // Always lands, so it proves nothing and is never learned
+      return;
+    }
+
+    Outcome outcome = pasteSelection(text, targetWindow, attempt, deadline, verbose);
+    if (outcome == Outcome::Delivered) {
+      m_strategies.learn(app, attempt);
+      return;
+    }
+    if (outcome == Outcome::Requested) return; // The keys arrived; another shortcut would paste twice
+    if (outcome == Outcome::Unanswered) {
+      Logger::instance().log(std::format("Paster: '{}' did not respond to {} in time; the text stays on the "
+                                         "clipboard for it.", app, PasteStrategyCache::name(attempt)));
+      return;
+    }
+    if (order.size() > 1) {
+      Logger::instance().log(std::format("Paster: '{}' ignored {}; trying the next strategy.", app,
+                                         PasteStrategyCache::name(attempt)));
+    }
+  }
+}
 
+/**
+ * @brief Runs one selection-based paste attempt.
+ *
+ * The user's clipboard is saved first and served again afterwards. CLIPBOARD is
+ * owned for every strategy: many applications read it, not PRIMARY, on
+ * Shift+Insert, and must get the text rather than the old clipboard. PRIMARY is
+ * not preserved.
+ *
+ * @param deadline When to give up waiting for the target, shared by the whole strategy chain.
+ * @return What the target did with the shortcut.
+ */
+inline Paster::Outcome Paster::pasteSelection(const std::string& text, Window targetWindow, PasteStrategy strategy,
+                                              Clock::time_point deadline, bool verbose) {
   if (verbose) std::cout << "Paster: Paste called." << std::endl;
+  auto start = Clock::now();
+
+  const bool usePrimary = (strategy == PasteStrategy::Primary);
+  Atom selection = usePrimary ? XA_PRIMARY : m_clipboard;
 
-  Atom clipboard = XInternAtom(m_display, "CLIPBOARD", False);
-  Atom utf8String = XInternAtom(m_display, "UTF8_STRING", False);
-  Atom targets = XInternAtom(m_display, "TARGETS", False);
+  // 0. Take the connection back from the serve thread and save the user's clipboard
+  stopServing();
+  m_lateText.clear();
+  snapshotClipboard();
+  auto snapshotted = Clock::now();
 
   // 1. Set Selection Owner
-  XSetSelectionOwner(m_display, clipboard, m_window, CurrentTime);
-  if (XGetSelectionOwner(m_display, clipboard) != m_window) {
-    if (verbose) std::cerr << "Paster: Failed to acquire clipboard ownership." << std::endl;
-    return;
+  XSetSelectionOwner(m_display, m_clipboard, m_window, CurrentTime);
+  if (usePrimary) XSetSelectionOwner(m_display, XA_PRIMARY, m_window, CurrentTime);
+  if (XGetSelectionOwner(m_display, m_clipboard) != m_window) clearSnapshot();
+  if (XGetSelectionOwner(m_display, selection) != m_window) {
+    if (verbose) std::cerr << "Paster: Failed to acquire selection ownership." << std::endl;
+    handBack(text, targetWindow, false);
+    return Outcome::Ignored; // No keys were sent
   }
-  if (verbose) std::cout << "Paster: Acquired clipboard ownership." << std::endl;
+  if (verbose) std::cout << "Paster: Acquired selection ownership." << std::endl;
 
-  // Restore focus if a target window was provided
+  // Restore focus if a target window was provided, and wait until it has it
   if (targetWindow != 0) {
-      if (verbose) {
-        std::cout << "Paster: Restoring focus to Window ID: " << targetWindow << std::endl;
+    restoreFocus(targetWindow, verbose);
+  }
+  auto focused = Clock::now();
+
+  // 2. Simulate the paste shortcut, then ping the target to learn when it has seen it
+  if (verbose) std::cout << "Paster: Simulating paste shortcut." << std::endl;
+  sendShortcut(strategy);
+  long ping = (targetWindow != 0) ? pingTarget(targetWindow) : 0;
+  if (verbose) std::cout << "Paster: Shortcut simulation complete." << std::endl;
+
+  // 3. Serve the SelectionRequests
+  // Block on the connection until the target app asks for the data, or until the
+  // deadline; a pong without a request cuts the wait short. INCR transfers keep
+  // the loop alive as long as the requestor makes progress.
+  auto wait = deadline;
+  XEvent e;
+  bool requested = false;
+  bool served = false;
+  bool answered = false;
+  bool lostOwnership = false;
+  m_transfers.clear();
+
+  if (verbose) std::cout << "Paster: Entering event loop." << std::endl;
+  while ((!served || !m_transfers.empty()) && nextEvent(e, wait)) {
+    if (e.type == SelectionRequest && e.xselectionrequest.owner == m_window) {
+      if (verbose) std::cout << "Paster: SelectionRequest received." << std::endl;
+      const XSelectionRequestEvent& req = e.xselectionrequest;
+      bool fromTarget = (targetWindow == 0) || sameClient(req.requestor, targetWindow);
+      if (req.selection == selection || (fromTarget && req.selection == m_clipboard)) {
+        // Other clients get the text too, but only the target's requests say the shortcut worked
+        bool delivered = serveRequest(req, text, verbose);
+        if (fromTarget) {
+          requested = true;
+          served = served || delivered;
+          wait = Clock::now() + std::chrono::seconds(2);
+        }
+      } else if (req.selection == m_clipboard) {
+        serveSaved(req); // Another client reading the user's clipboard during a PRIMARY paste
       }
-      XSetInputFocus(m_display, targetWindow, RevertToParent, CurrentTime);
+    } else if (e.type == PropertyNotify && !m_transfers.empty()) {
+      bool fromTarget = (targetWindow == 0) || sameClient(e.xproperty.window, targetWindow);
+      if (advanceTransfer(e.xproperty, verbose) && fromTarget) served = true;
+      wait = Clock::now() + std::chrono::seconds(2);
+    } else if (e.type == ClientMessage && ping != 0 && e.xclient.message_type == m_wmProtocols &&
+               (Atom)e.xclient.data.l[0] == m_wmPing && e.xclient.data.l[1] == ping) {
+      if (verbose) std::cout << "Paster: Target answered the ping." << std::endl;
+      answered = true;
+      // A request the keys triggered may still be on its way from a helper process
+      if (!requested) wait = std::min(wait, Clock::now() + std::chrono::milliseconds(250));
+    } else if (e.type == SelectionClear && e.xselectionclear.window == m_window) {
+      if (verbose) std::cout << "Paster: SelectionClear received." << std::endl;
+      if (e.xselectionclear.selection == m_clipboard) clearSnapshot();
+      if (e.xselectionclear.selection != selection) continue;
+      // We lost ownership, so we're done once started transfers have finished.
+      lostOwnership = true;
+      if (m_transfers.empty()) break;
+    }
+  }
+  if (ping != 0) XSelectInput(m_display, DefaultRootWindow(m_display), NoEventMask);
+  if (!m_transfers.empty()) {
+    Logger::instance().error(std::format("Paster: {} INCR transfer(s) stalled; abandoned.", m_transfers.size()));
+    for (const auto& t : m_transfers) XSelectInput(m_display, t.requestor, NoEventMask);
+    m_transfers.clear();
+  }
+  if (verbose && !served) std::cout << "Paster: Event loop timed out." << std::endl;
+  if (verbose) std::cout << "Paster: Paste finished." << std::endl;
+
+  Outcome outcome = served ? Outcome::Delivered
+                  : requested ? Outcome::Requested
+                  : answered ? Outcome::Ignored
+                  : Outcome::Unanswered;
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  auto pasted = Clock::now();
+  Logger::instance().log(std::format("Paster: focus {:.1f} ms, text-to-screen {:.1f} ms{}.",
+                                     ms(focused - snapshotted), ms(pasted - start),
+                                     served ? "" : requested ? " (incomplete)"
+                                     : answered ? " (ignored)" : " (no answer)"));
+
+  // 4. Hand the clipboard back: answer from the snapshot, or let it go as before
+  handBack(text, targetWindow, outcome == Outcome::Unanswered && !lostOwnership);
+  if (!m_saved.empty()) {
+    Logger::instance().log(std::format("Clipboard: previous contents restored; overhead {:.2f} ms "
+                                       "(snapshot {:.2f} ms, restore {:.2f} ms).",
+                                       ms(snapshotted - start) + ms(Clock::now() - pasted),
+                                       ms(snapshotted - start), ms(Clock::now() - pasted)));
+  }
+  return outcome;
+}
+
+/**
+ * @brief Sends _NET_WM_PING to the target's toplevel, if it takes part in the protocol.
+ *
+ * A client handles its events in order, so its pong shows that it has processed
+ * the keys sent before the ping.
+ *
+ * @return The ping's timestamp to match the pong against, or 0 if the target cannot be pinged.
+ */
+inline long Paster::pingTarget(Window targetWindow) {
+  Window root = DefaultRootWindow(m_display);
+  Window current = targetWindow;
+  for (int depth = 0; current != 0 && current != root && current != PointerRoot && depth < 16; ++depth) {
+    Atom* protocols = nullptr;
+    int count = 0;
+    if (XGetWMProtocols(m_display, current, &protocols, &count)) {
+      bool supported = std::find(protocols, protocols + count, m_wmPing) != protocols + count;
+      XFree(protocols);
+      if (!supported) return 0;
+
+      // The pong goes to the root window; only substructure listeners see it
+      XSelectInput(m_display, root, SubstructureNotifyMask);
+      XEvent ping = {};
+      ping.xclient.type = ClientMessage;
+      ping.xclient.window = current;
+      ping.xclient.message_type = m_wmProtocols;
+      ping.xclient.format = 32;
+      ping.xclient.data.l[0] = (long)m_wmPing;
+      ping.xclient.data.l[1] = ++m_pingStamp;
+      ping.xclient.data.l[2] = (long)current;
+      XSendEvent(m_display, current, False, NoEventMask, &ping);
       XFlush(m_display);
+      return m_pingStamp;
+    }
+
+    Window parent;
+    Window* children = nullptr;
+    unsigned int childCount = 0;
+    if (!XQueryTree(m_display, current, &root, &parent, &children, &childCount)) return 0;
+    if (children) XFree(children);
+    current = parent;
+  }
+  return 0;
+}
+
+inline void Paster::prepare(Window targetWindow) {
+  if (targetWindow != 0) m_strategies.appClass(targetWindow);
+}
+
+/**
+ * @brief Gives the keyboard focus back to the target and waits for confirmation.
+ *
+ * Listens for FocusIn on the target and for _NET_ACTIVE_WINDOW changes on the
+ * root window, and checks the real focus whenever one arrives. Returns as soon
+ * as the focus is confirmed, or after 200ms.
+ *
+ * @return true if the focus change was confirmed.
+ */
+inline bool Paster::restoreFocus(Window targetWindow, bool verbose) {
+  Window root = DefaultRootWindow(m_display);
+  Window focus = 0;
+  int revert;
+  XGetInputFocus(m_display, &focus, &revert);
+  if (focus == targetWindow) return true;
+  if (targetWindow == PointerRoot) return false;
+
+  if (verbose) {
+    std::cout << "Paster: Restoring focus to Window ID: " << targetWindow << std::endl;
   }
 
-  // 2. Simulate Ctrl+V (Wait a bit for focus to settle if window was just closed)
-  std::this_thread::sleep_for(std::chrono::milliseconds(200)); 
+  // Each client has its own event mask on a window, so this leaves the target's own alone
+  XSelectInput(m_display, targetWindow, FocusChangeMask);
+  XSelectInput(m_display, root, PropertyChangeMask);
+  XSetInputFocus(m_display, targetWindow, RevertToParent, CurrentTime);
+  XFlush(m_display);
+
+  Atom activeWindow = X11Connection::instance().atom("_NET_ACTIVE_WINDOW");
+  auto deadline = Clock::now() + std::chrono::milliseconds(200);
+  bool confirmed = false;
+  XEvent e;
+  std::vector<XEvent> others; // Selection traffic meanwhile is for the caller's loop
+
+  while (!confirmed && nextEvent(e, deadline)) {
+    bool candidate = (e.type == FocusIn && e.xfocus.window == targetWindow) ||
+                     (e.type == PropertyNotify && e.xproperty.window == root && e.xproperty.atom == activeWindow);
+    if (!candidate) {
+      if (e.type == SelectionRequest || e.type == SelectionClear || e.type == PropertyNotify) others.push_back(e);
+      continue;
+    }
+
+    XGetInputFocus(m_display, &focus, &revert);
+    confirmed = (focus == targetWindow);
+  }
+  for (auto it = others.rbegin(); it != others.rend(); ++it) XPutBackEvent(m_display, &*it);
+
+  XSelectInput(m_display, targetWindow, NoEventMask);
+  XSelectInput(m_display, root, NoEventMask);
+  XFlush(m_display);
+
+  if (!confirmed) {
+    Logger::instance().log("Paster: Focus change not confirmed within 200 ms; pasting anyway.");
+  }
+  return confirmed;
+}
+
+/**
+ * @brief Returns true if two XIDs were allocated by the same X client.
+ */
+inline bool Paster::sameClient(Window a, Window b) const {
+  return (a & ~m_resourceMask) == (b & ~m_resourceMask);
+}
 
+/**
+ * @brief Presses and releases the strategy's paste shortcut through XTest.
+ */
+inline void Paster::sendShortcut(PasteStrategy strategy) {
   KeyCode ctrlKey = XKeysymToKeycode(m_display, XK_Control_L);
   KeyCode shiftKey = XKeysymToKeycode(m_display, XK_Shift_L);
-  KeyCode vKey = XKeysymToKeycode(m_display, XK_v);
+  KeyCode key = XKeysymToKeycode(m_display, strategy == PasteStrategy::Primary ? XK_Insert : XK_v);
+  bool useCtrl = (strategy != PasteStrategy::Primary);
+  bool useShift = (strategy != PasteStrategy::CtrlV);
+
+  if (useCtrl) XTestFakeKeyEvent(m_display, ctrlKey, True, 0);   // Ctrl Down
+  if (useShift) XTestFakeKeyEvent(m_display, shiftKey, True, 0); // Shift Down
+  XTestFakeKeyEvent(m_display, key, True, 0);                    // V / Insert Down
+  XTestFakeKeyEvent(m_display, key, False, 0);                   // V / Insert Up
+  if (useShift) XTestFakeKeyEvent(m_display, shiftKey, False, 0); // Shift Up
+  if (useCtrl) XTestFakeKeyEvent(m_display, ctrlKey, False, 0);   // Ctrl Up
+  XFlush(m_display);
+}
+
+/**
+ * @brief Background thread body: answers CLIPBOARD requests from the snapshot.
+ *
+ * After an unanswered paste attempt the target's first request gets the text
+ * instead; PRIMARY stays ours only for that. Runs until stopServing() writes to
+ * the wake pipe, or until another client takes the selections, which makes the
+ * snapshot obsolete.
+ */
+inline void Paster::serveLoop() {
+  pollfd fds[2] = { { ConnectionNumber(m_display), POLLIN, 0 }, { m_wakePipe[0], POLLIN, 0 } };
+  bool ownClipboard = XGetSelectionOwner(m_display, m_clipboard) == m_window;
+  bool ownPrimary = XGetSelectionOwner(m_display, XA_PRIMARY) == m_window;
+
+  // Once the late text is fetched, the clipboard is the user's again and PRIMARY is let go
+  auto lateDelivered = [&]() {
+    for (const auto& t : m_transfers) {
+      if (t.storage == None) return; // Still reading from m_lateText
+    }
+    m_lateText.clear();
+    if (ownPrimary) XSetSelectionOwner(m_display, XA_PRIMARY, None, CurrentTime);
+    ownPrimary = false;
+    if (m_saved.empty() && ownClipboard) XSetSelectionOwner(m_display, m_clipboard, None, CurrentTime);
+    ownClipboard = ownClipboard && !m_saved.empty();
+    XFlush(m_display);
+  };
 
-  if (verbose) std::cout << "Paster: Simulating Ctrl+V." << std::endl;
-  XTestFakeKeyEvent(m_display, ctrlKey, True, 0);  // Ctrl Down
-  if (useShift) {
-      XTestFakeKeyEvent(m_display, shiftKey, True, 0); // Shift Down
+  while (ownClipboard || ownPrimary) {
+    while (XPending(m_display) > 0) {
+      XEvent e;
+      XNextEvent(m_display, &e);
+      if (e.type == SelectionRequest && e.xselectionrequest.owner == m_window) {
+        const XSelectionRequestEvent& req = e.xselectionrequest;
+        if (!m_lateText.empty() && (m_lateTarget == 0 || sameClient(req.requestor, m_lateTarget))) {
+          if (serveRequest(req, m_lateText, false)) lateDelivered();
+        } else {
+          serveSaved(req);
+        }
+      } else if (e.type == PropertyNotify && !m_transfers.empty()) {
+        bool late = !m_lateText.empty() && (m_lateTarget == 0 || sameClient(e.xproperty.window, m_lateTarget));
+        if (advanceTransfer(e.xproperty, false) && late) lateDelivered();
+      } else if (e.type == SelectionClear && e.xselectionclear.window == m_window) {
+        if (e.xselectionclear.selection == m_clipboard) {
+          ownClipboard = false;
+          clearSnapshot();
+        } else if (e.xselectionclear.selection == XA_PRIMARY) {
+          ownPrimary = false;
+        }
+      }
+    }
+    if (!ownClipboard && !ownPrimary) break;
+
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) return;
+    if (fds[1].revents & POLLIN) return;
   }
-  XTestFakeKeyEvent(m_display, vKey, True, 0);     // V Down
-  XTestFakeKeyEvent(m_display, vKey, False, 0);    // V Up
-  if (useShift) {
-      XTestFakeKeyEvent(m_display, shiftKey, False, 0); // Shift Up
+
+  // Nothing left to serve: drop whatever transfers were still running
+  for (const auto& t : m_transfers) XSelectInput(m_display, t.requestor, NoEventMask);
+  m_transfers.clear();
+  m_lateText.clear();
+  clearSnapshot();
+  XFlush(m_display);
+}
+
+/**
+ * @brief Answers one SelectionRequest for the CLIPBOARD.
+ *
+ * Text that does not fit in one request is announced as INCR; the chunks follow
+ * from advanceTransfer() as the requestor deletes the property.
+ *
+ * @return true if the text itself was delivered (as opposed to TARGETS, a refusal
+ *         or the start of an INCR transfer).
+ */
+inline bool Paster::serveRequest(const XSelectionRequestEvent& req, const std::string& text, bool verbose) {
+  Atom utf8String = X11Connection::instance().atom("UTF8_STRING");
+  Atom targets = m_targets;
+  bool served = false;
+
+  XSelectionEvent s;
+  s.type = SelectionNotify;
+  s.requestor = req.requestor;
+  s.selection = req.selection;
+  s.target = req.target;
+  s.property = req.property;
+  s.time = req.time;
+
+  if (req.target == targets) {
+      if (verbose) std::cout << "Paster: Serving TARGETS." << std::endl;
+      Atom supported[] = { utf8String, XA_STRING };
+      XChangeProperty(m_display, s.requestor, s.property, XA_ATOM, 32,
+                      PropModeReplace, (unsigned char*)supported, 2);
+  } else if ((req.target == utf8String || req.target == XA_STRING) && text.size() > m_chunkSize) {
+      if (verbose) std::cout << "Paster: Starting INCR transfer of " << text.size() << " bytes." << std::endl;
+      // Watch the requestor's property deletions before announcing, so none is missed
+      XSelectInput(m_display, s.requestor, PropertyChangeMask);
+      long size = (long)text.size();
+      XChangeProperty(m_display, s.requestor, s.property, m_incr, 32,
+                      PropModeReplace, (unsigned char*)&size, 1);
+      m_transfers.push_back({ s.requestor, s.property, req.target, 8, text, None, 0, text.size() });
+  } else if (req.target == utf8String || req.target == XA_STRING) {
+      if (verbose) std::cout << "Paster: Serving UTF8_STRING." << std::endl;
+      XChangeProperty(m_display, s.requestor, s.property, req.target, 8,
+                      PropModeReplace, (unsigned char*)text.c_str(), text.length());
+      served = true;
+  } else {
+      if (verbose) std::cout << "Paster: Unknown target requested." << std::endl;
+      s.property = None;
   }
-  XTestFakeKeyEvent(m_display, ctrlKey, False, 0); // Ctrl Up
+
+  XSendEvent(m_display, req.requestor, True, 0, (XEvent*)&s);
+  XFlush(m_display);
+  return served;
+}
+
+/**
+ * @brief Answers a SelectionRequest from the saved clipboard properties.
+ *
+ * Small targets are copied server-to-requestor in one read; larger ones go out
+ * through INCR, one chunk in memory at a time. Requests for other selections
+ * (PRIMARY, held only for a late paste) are refused.
+ */
+inline void Paster::serveSaved(const XSelectionRequestEvent& req) {
+  XSelectionEvent s;
+  s.type = SelectionNotify;
+  s.requestor = req.requestor;
+  s.selection = req.selection;
+  s.target = req.target;
+  s.property = (req.property != None) ? req.property : req.target; // Obsolete clients pass None
+  s.time = req.time;
+
+  auto saved = std::find_if(m_saved.begin(), m_saved.end(),
+                            [&](const SavedTarget& t) { return t.target == req.target; });
+
+  if (req.selection != m_clipboard) {
+    s.property = None;
+  } else if (req.target == m_targets) {
+    std::vector<Atom> offered = { m_targets };
+    for (const auto& t : m_saved) offered.push_back(t.target);
+    XChangeProperty(m_display, s.requestor, s.property, XA_ATOM, 32, PropModeReplace,
+                    (unsigned char*)offered.data(), (int)offered.size());
+  } else if (saved != m_saved.end() && saved->bytes > m_chunkSize) {
+    XSelectInput(m_display, s.requestor, PropertyChangeMask);
+    long size = (long)saved->bytes;
+    XChangeProperty(m_display, s.requestor, s.property, m_incr, 32, PropModeReplace, (unsigned char*)&size, 1);
+    m_transfers.push_back({ s.requestor, s.property, saved->type, saved->format, {}, saved->storage, 0, saved->bytes });
+  } else if (saved != m_saved.end()) {
+    Atom type;
+    int format;
+    unsigned long items, after;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(m_display, m_window, saved->storage, 0, (long)(saved->bytes + 3) / 4, False,
+                           AnyPropertyType, &type, &format, &items, &after, &data) == Success && data) {
+      XChangeProperty(m_display, s.requestor, s.property, saved->type, saved->format, PropModeReplace,
+                      data, (int)items);
+      XFree(data);
+    } else {
+      s.property = None;
+    }
+  } else {
+    s.property = None;
+  }
+
+  XSendEvent(m_display, req.requestor, True, 0, (XEvent*)&s);
+  XFlush(m_display);
+}
+
+/**
+ * @brief Saves the small targets of the current CLIPBOARD owner into properties on our window.
+ *
+ * All conversions are requested at once and answered in parallel. Only replies
+ * of up to 64 KiB are kept: a larger target would cost a server-side copy, and
+ * an INCR one many round trips, on the paste path, and once we own the selection
+ * the previous owner cannot be asked again. Those are dropped and logged, as is
+ * anything not delivered within 100ms.
+ */
+inline void Paster::snapshotClipboard() {
+  Window owner = XGetSelectionOwner(m_display, m_clipboard);
+  if (owner == m_window) return; // Still holding the snapshot from the last paste
+  clearSnapshot();
+  if (owner == None) return;
+
+  const size_t maxTargets = 32;
+  const size_t maxBytes = 64 * 1024;
+  auto start = Clock::now();
+  auto deadline = start + std::chrono::milliseconds(100);
+  X11Connection& x11 = X11Connection::instance();
+  Atom targetsProp = x11.atom("VOICECLI_TARGETS");
+
+  // 1. Which targets does the owner offer?
+  XConvertSelection(m_display, m_clipboard, m_targets, targetsProp, m_window, CurrentTime);
   XFlush(m_display);
-  if (verbose) std::cout << "Paster: Ctrl+V simulation complete." << std::endl;
 
-  // 3. Serve the SelectionRequest
-  // We need to wait for the target app to ask for the data.
-  // We'll poll for events with a timeout.
-  auto start = std::chrono::steady_clock::now();
   XEvent e;
-  bool served = false;
+  bool answered = false;
+  while (!answered && nextEvent(e, deadline)) {
+    answered = (e.type == SelectionNotify && e.xselection.requestor == m_window && e.xselection.target == m_targets);
+  }
+  if (!answered || e.xselection.property == None) {
+    Logger::instance().log("Clipboard: Previous owner did not list its targets; not preserved.");
+    return;
+  }
 
-  if (verbose) std::cout << "Paster: Entering event loop." << std::endl;
-  while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
-    // Use a non-blocking check for events
-    if (XCheckTypedWindowEvent(m_display, m_window, SelectionRequest, &e) ||
-        XCheckTypedWindowEvent(m_display, m_window, SelectionClear, &e)) {
-      
-      if (e.type == SelectionRequest) {
-        if (verbose) std::cout << "Paster: SelectionRequest received." << std::endl;
-        if (e.xselectionrequest.selection == clipboard) {
-          XSelectionEvent s;
-          s.type = SelectionNotify;
-          s.requestor = e.xselectionrequest.requestor;
-          s.selection = e.xselectionrequest.selection;
-          s.target = e.xselectionrequest.target;
-          s.property = e.xselectionrequest.property;
-          s.time = e.xselectionrequest.time;
-
-          if (e.xselectionrequest.target == targets) {
-              if (verbose) std::cout << "Paster: Serving TARGETS." << std::endl;
-              Atom supported[] = { utf8String, XA_STRING };
-              XChangeProperty(m_display, s.requestor, s.property, XA_ATOM, 32, 
-                              PropModeReplace, (unsigned char*)supported, 2);
-          } else if (e.xselectionrequest.target == utf8String || e.xselectionrequest.target == XA_STRING) {
-              if (verbose) std::cout << "Paster: Serving UTF8_STRING." << std::endl;
-              XChangeProperty(m_display, s.requestor, s.property, e.xselectionrequest.target, 8, 
-                              PropModeReplace, (unsigned char*)text.c_str(), text.length());
-              served = true;
-          } else {
-              if (verbose) std::cout << "Paster: Unknown target requested." << std::endl;
-              s.property = None; 
-          }
-
-          XSendEvent(m_display, e.xselectionrequest.requestor, True, 0, (XEvent*)&s);
-          XFlush(m_display);
-          
-          if (served) break; 
-        }
-      } else if (e.type == SelectionClear) {
-        if (verbose) std::cout << "Paster: SelectionClear received." << std::endl;
-        // We lost ownership, so we're done.
-        break;
-      }
+  std::vector<Atom> offered;
+  {
+    Atom type;
+    int format;
+    unsigned long items, after;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(m_display, m_window, targetsProp, 0, 1024, True, XA_ATOM, &type, &format,
+                           &items, &after, &data) == Success && data) {
+      if (format == 32) offered.assign((Atom*)data, (Atom*)data + items);
+      XFree(data);
+    }
+  }
+
+  // 2. Convert every real data target; the server keeps the results
+  struct Pending {
+    SavedTarget saved; // storage is the property the owner writes to
+    bool done;
+  };
+  std::vector<Atom> skip = { m_targets, m_incr, x11.atom("MULTIPLE"), x11.atom("TIMESTAMP"),
+                             x11.atom("SAVE_TARGETS"), x11.atom("DELETE") };
+  std::vector<Pending> pending;
+  for (Atom target : offered) {
+    if (pending.size() == maxTargets) break;
+    if (std::find(skip.begin(), skip.end(), target) != skip.end()) continue;
+
+    Atom storage = x11.atom(std::format("VOICECLI_CLIP_{}", pending.size()));
+    XConvertSelection(m_display, m_clipboard, target, storage, m_window, CurrentTime);
+    pending.push_back({ { target, None, 0, storage, 0 }, false });
+  }
+  XFlush(m_display);
+
+  std::vector<Atom> dropped; // Too large to keep
+  size_t open = pending.size();
+  while (open > 0 && nextEvent(e, deadline)) {
+    if (e.type != SelectionNotify || e.xselection.requestor != m_window) continue;
+    auto p = std::find_if(pending.begin(), pending.end(),
+                          [&](const Pending& q) { return !q.done && q.saved.target == e.xselection.target; });
+    if (p == pending.end()) continue;
+    p->done = true;
+    --open;
+    if (e.xselection.property == None) continue;
+
+    // A zero-length read tells the type and size without copying the data
+    Atom type = None;
+    int format = 0;
+    unsigned long items = 0, after = 0;
+    unsigned char* data = nullptr;
+    XGetWindowProperty(m_display, m_window, p->saved.storage, 0, 0, False, AnyPropertyType, &type, &format,
+                       &items, &after, &data);
+    if (data) XFree(data);
+    if (type == m_incr || after > maxBytes) {
+      // Leaving an INCR property alone asks the owner for nothing more
+      dropped.push_back(p->saved.target);
+    } else if (type != None) {
+      p->saved.type = type;
+      p->saved.format = format;
+      p->saved.bytes = after;
+    }
+  }
+
+  // 3. Keep what arrived; drop the rest
+  size_t bytes = 0;
+  for (const auto& p : pending) {
+    if (p.done && p.saved.bytes > 0 && p.saved.type != None) {
+      m_saved.push_back(p.saved);
+      bytes += p.saved.bytes;
     } else {
-      // No event, sleep briefly to avoid busy-waiting
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      XDeleteProperty(m_display, m_window, p.saved.storage);
     }
   }
-  if (verbose && !served) std::cout << "Paster: Event loop timed out." << std::endl;
-  if (verbose) std::cout << "Paster: Paste finished." << std::endl;
+  XFlush(m_display);
+
+  Logger::instance().log(std::format("Clipboard: Saved {} of {} targets ({:.1f} KiB, held by the X server) in {:.2f} ms.",
+                                     m_saved.size(), pending.size(), bytes / 1024.0,
+                                     std::chrono::duration<double, std::milli>(Clock::now() - start).count()));
+  if (!dropped.empty()) {
+    std::string names;
+    for (Atom target : dropped) {
+      char* name = XGetAtomName(m_display, target);
+      names += std::format("{}{}", names.empty() ? "" : ", ", name ? name : "?");
+      if (name) XFree(name);
+    }
+    Logger::instance().log(std::format("Clipboard: Not preserving targets over {} KiB: {}.", maxBytes / 1024, names));
+  }
+}
+
+/**
+ * @brief Hands the paste connection to the serve thread.
+ */
+inline void Paster::startServing() {
+  if (m_serveThread.joinable()) return;
+  m_serveThread = std::thread(&Paster::serveLoop, this);
+}
+
+/**
+ * @brief Stops the serve thread and takes the paste connection back.
+ */
+inline void Paster::stopServing() {
+  if (!m_serveThread.joinable()) return;
+  char wake = 1;
+  if (write(m_wakePipe[1], &wake, 1) < 0) {
+    Logger::instance().error("Paster: Failed to wake the clipboard thread.");
+  }
+  m_serveThread.join();
+
+  char drain[16];
+  while (read(m_wakePipe[0], drain, sizeof(drain)) > 0) {
+  }
+}
+
+inline void Paster::type(const std::string& text, Window targetWindow, bool verbose) {
+  if (text.empty()) return;
+  typeText(text, targetWindow, verbose);
+}
+
+inline void Paster::typeText(const std::string& text, Window targetWindow, bool verbose) {
+  // The clipboard thread owns the connection; borrow it and hand it back afterwards
+  bool wasServing = m_serveThread.joinable();
+  stopServing();
+
+  if (!m_typer) m_typer = std::make_unique<KeyTyper>(m_display);
+  if (targetWindow != 0) {
+    restoreFocus(targetWindow, verbose);
+  }
+  if (verbose) std::cout << "Paster: Typing " << text.size() << " bytes." << std::endl;
+  m_typer->type(text);
+
+  if (wasServing && (!m_saved.empty() || !m_lateText.empty())) startServing();
 }
 
 #endif // VOICECLI_SRC_PASTER_HPP
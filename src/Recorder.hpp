@@ -9,14 +9,23 @@
 #include <atomic>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
 
 #include "../third_party/miniaudio.h"
+#include "FlightRecorder.hpp"
+#include "Spectrogram.hpp"
+#include "Trace.hpp"
 
 /**
  * @brief Handles audio recording using miniaudio.
  * 
  * Captures audio from a specific device, encodes it to WAV, and calculates
- * real-time volume levels.
+ * real-time volume levels. Written frames are also mirrored into a lock-free
+ * ring buffer so the session can keep the recording in memory (see drain()).
+ *
+ * The recorder normally opens its own capture device. It can instead be fed by
+ * a stream someone else keeps open (see feed()), so a session started by the
+ * wake word continues the listener's stream without a gap.
  */
 class Recorder {
 public:
@@ -39,9 +48,12 @@ public:
    * Initializes the encoder and starts the audio device.
    * 
    * @param outputFile Path to the output WAV file.
+   * @param preRoll Audio captured before the session (e.g. the wake word window),
+   *        written to the file ahead of the live stream. Must be at the recorder's rate.
+   * @param ownDevice false to open no device and take the audio from feed() instead.
    * @throws std::runtime_error If file or device initialization fails.
    */
-  void start(const std::string& outputFile);
+  void start(const std::string& outputFile, const std::vector<float>& preRoll = {}, bool ownDevice = true);
 
   /**
    * @brief Stops recording and finalizes the output file.
@@ -58,6 +70,35 @@ public:
    */
   void resume();
 
+  /**
+   * @brief Moves captured samples from the ring buffer into a vector.
+   *
+   * Only frames that were written (i.e. not discarded by setWriting(false)) are
+   * delivered. Call at least every second while recording; frames that do not
+   * fit into the ring are dropped and counted in getOverrunFrames().
+   *
+   * @param out Receives the samples (appended), at the recorder's sample rate.
+   * @return The number of samples appended.
+   */
+  size_t drain(std::vector<float>& out);
+
+  /**
+   * @brief Processes captured frames, from the recorder's own device or an external stream.
+   *
+   * Real-time safe; call from one capture thread at a time. Ignored unless recording and not paused.
+   */
+  void feed(const float* samples, ma_uint32 frameCount);
+
+  /**
+   * @brief Returns the number of frames dropped because the ring buffer was full, since start().
+   */
+  uint64_t getOverrunFrames() const;
+
+  /**
+   * @brief Returns the capture sample rate in Hz.
+   */
+  unsigned int getSampleRate() const;
+
   /**
    * @brief Checks if the recorder is currently active.
    * @return true if recording, false otherwise.
@@ -81,6 +122,12 @@ public:
    */
   void setWriting(bool writing);
 
+  /**
+   * @brief Feeds every captured frame (written or not) to a spectrogram.
+   * @param tap The analyzer, or nullptr to stop feeding. Must outlive the recording.
+   */
+  void setSpectrogram(Spectrogram* tap);
+
 private:
   static void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
 
@@ -88,10 +135,14 @@ private:
   ma_device_config m_deviceConfig;
   ma_encoder m_encoder;
   ma_encoder_config m_encoderConfig;
-  bool m_isRecording;
+  ma_pcm_rb m_ring;
+  std::atomic<bool> m_isRecording;
   bool m_isInitialized;
+  std::atomic<bool> m_isPaused; // Fed externally and paused
   std::atomic<float> m_currentLevel;
   std::atomic<bool> m_isWriting;
+  std::atomic<uint64_t> m_overrunFrames;
+  std::atomic<Spectrogram*> m_spectrogram;
 };
 
 // -----------------------------------------------------------------------------
@@ -99,7 +150,8 @@ private:
 // -----------------------------------------------------------------------------
 
 inline Recorder::Recorder(ma_device_id* pDeviceID, unsigned int sampleRate) 
-    : m_isRecording(false), m_isInitialized(false), m_currentLevel(0.0f), m_isWriting(true) {
+    : m_isRecording(false), m_isInitialized(false), m_isPaused(false), m_currentLevel(0.0f), m_isWriting(true),
+      m_overrunFrames(0), m_spectrogram(nullptr) {
   // Configure Device
   m_deviceConfig = ma_device_config_init(ma_device_type_capture);
   m_deviceConfig.capture.pDeviceID = pDeviceID; 
@@ -110,19 +162,23 @@ inline Recorder::Recorder(ma_device_id* pDeviceID, unsigned int sampleRate)
   m_deviceConfig.sampleRate = sampleRate;
   m_deviceConfig.dataCallback = data_callback;
   m_deviceConfig.pUserData = this;
+
+  // Two seconds of headroom between the audio thread and the session loop
+  if (ma_pcm_rb_init(ma_format_f32, 1, sampleRate * 2, NULL, NULL, &m_ring) != MA_SUCCESS) {
+    throw std::runtime_error("Failed to allocate capture ring buffer.");
+  }
 }
 
 inline Recorder::~Recorder() {
   stop();
+  ma_pcm_rb_uninit(&m_ring);
 }
 
 /**
  * @brief Static callback function for miniaudio device data.
- * 
- * This function is called by miniaudio when new audio frames are available.
- * It writes the frames to the encoder if recording is active and calculates
- * the peak audio level for the volume meter.
- * 
+ *
+ * Called by miniaudio when new audio frames are available; hands them to feed().
+ *
  * @param pDevice Pointer to the miniaudio device.
  * @param pOutput Pointer to the output buffer (unused for capture).
  * @param pInput Pointer to the input audio frames.
@@ -130,41 +186,94 @@ inline Recorder::~Recorder() {
  */
 inline void Recorder::data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
   Recorder* pRecorder = (Recorder*)pDevice->pUserData;
-  if (pRecorder && pRecorder->m_isRecording) {
-    if (pRecorder->m_isWriting.load(std::memory_order_relaxed)) {
-        ma_encoder_write_pcm_frames(&pRecorder->m_encoder, pInput, frameCount, NULL);
+  if (pRecorder) pRecorder->feed((const float*)pInput, frameCount);
+  (void)pOutput; // Unused
+}
+
+inline size_t Recorder::drain(std::vector<float>& out) {
+  size_t total = 0;
+  for (int round = 0; round < 2; ++round) {
+    ma_uint32 chunk = ma_pcm_rb_available_read(&m_ring);
+    void* pSrc;
+    if (chunk == 0 || ma_pcm_rb_acquire_read(&m_ring, &chunk, &pSrc) != MA_SUCCESS) break;
+    const float* samples = (const float*)pSrc;
+    out.insert(out.end(), samples, samples + chunk);
+    ma_pcm_rb_commit_read(&m_ring, chunk);
+    total += chunk;
+  }
+  return total;
+}
+
+/**
+ * @brief Writes the frames to the encoder and the in-memory ring buffer if recording
+ * is active, and calculates the peak audio level for the volume meter.
+ */
+inline void Recorder::feed(const float* samples, ma_uint32 frameCount) {
+  if (m_isRecording.load(std::memory_order_relaxed) && !m_isPaused.load(std::memory_order_relaxed)) {
+    if (m_isWriting.load(std::memory_order_relaxed)) {
+        ma_encoder_write_pcm_frames(&m_encoder, samples, frameCount, NULL);
+
+        // Mirror into the ring buffer; it may wrap, so take at most two rounds.
+        const float* src = samples;
+        ma_uint32 remaining = frameCount;
+        for (int round = 0; round < 2 && remaining > 0; ++round) {
+            ma_uint32 chunk = remaining;
+            void* pDst;
+            if (ma_pcm_rb_acquire_write(&m_ring, &chunk, &pDst) != MA_SUCCESS || chunk == 0) break;
+            std::copy(src, src + chunk, (float*)pDst);
+            ma_pcm_rb_commit_write(&m_ring, chunk);
+            src += chunk;
+            remaining -= chunk;
+        }
+        if (remaining > 0 && m_overrunFrames.fetch_add(remaining, std::memory_order_relaxed) == 0) {
+            FlightRecorder::record("audio.overrun", "frames", remaining); // First one of the take only
+        }
+    }
+
+    if (Spectrogram* tap = m_spectrogram.load(std::memory_order_acquire)) {
+        tap->push(samples, frameCount);
     }
 
     // Level Meter Calculation (Peak)
     float maxVal = 0.0f;
-    const float* samples = (const float*)pInput;
     for (ma_uint32 i = 0; i < frameCount; ++i) {
         float val = std::abs(samples[i]);
         if (val > maxVal) maxVal = val;
     }
 
-    float current = pRecorder->m_currentLevel.load(std::memory_order_relaxed);
+    float current = m_currentLevel.load(std::memory_order_relaxed);
     if (maxVal > current) {
-        pRecorder->m_currentLevel.store(maxVal, std::memory_order_relaxed);
+        m_currentLevel.store(maxVal, std::memory_order_relaxed);
     } else {
         // Smooth decay
-        pRecorder->m_currentLevel.store(current * 0.90f, std::memory_order_relaxed);
+        m_currentLevel.store(current * 0.90f, std::memory_order_relaxed);
     }
   }
-  (void)pOutput; // Unused
 }
 
 inline float Recorder::getCurrentLevel() const {
     return m_currentLevel.load(std::memory_order_relaxed);
 }
 
+inline uint64_t Recorder::getOverrunFrames() const {
+    return m_overrunFrames.load(std::memory_order_relaxed);
+}
+
+inline unsigned int Recorder::getSampleRate() const {
+  return m_deviceConfig.sampleRate;
+}
+
 inline bool Recorder::isRecording() const {
   return m_isRecording;
 }
 
 inline void Recorder::pause() {
-  if (m_isInitialized && m_isRecording) {
+  if (!m_isInitialized && m_isRecording) {
+    m_isPaused.store(true); // Fed externally: the stream keeps running, we ignore it
+    FlightRecorder::record("device.pause");
+  } else if (m_isInitialized && m_isRecording) {
     ma_device_stop(&m_device);
+    FlightRecorder::record("device.pause");
     // We don't change m_isRecording here because we want to keep the encoder open.
     // But conceptually we are "paused". 
     // Data callback won't be called, so nothing written.
@@ -172,8 +281,12 @@ inline void Recorder::pause() {
 }
 
 inline void Recorder::resume() {
-  if (m_isInitialized && m_isRecording) {
-    ma_device_start(&m_device);
+  if (!m_isInitialized && m_isRecording) {
+    m_isPaused.store(false);
+    FlightRecorder::record("device.resume");
+  } else if (m_isInitialized && m_isRecording) {
+    ma_result result = ma_device_start(&m_device);
+    FlightRecorder::record("device.resume", "result", result);
   }
 }
 
@@ -181,31 +294,57 @@ inline void Recorder::setWriting(bool writing) {
     m_isWriting.store(writing, std::memory_order_relaxed);
 }
 
-inline void Recorder::start(const std::string& outputFile) {
+inline void Recorder::setSpectrogram(Spectrogram* tap) {
+    m_spectrogram.store(tap, std::memory_order_release);
+}
+
+inline void Recorder::start(const std::string& outputFile, const std::vector<float>& preRoll, bool ownDevice) {
   if (m_isRecording) return;
+  TRACE_SCOPE("Recorder::start");
 
   // Initialize Encoder (WAV file)
   m_encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, 1, m_deviceConfig.sampleRate);
   if (ma_encoder_init_file(outputFile.c_str(), &m_encoderConfig, &m_encoder) != MA_SUCCESS) {
     throw std::runtime_error("Failed to initialize audio output file.");
   }
+
+  if (!preRoll.empty()) {
+    ma_encoder_write_pcm_frames(&m_encoder, preRoll.data(), preRoll.size(), NULL);
+  }
   
   m_isWriting.store(true); // Default to writing
+  m_isPaused.store(false);
+  ma_pcm_rb_reset(&m_ring); // Drop anything left over from a previous take
+  m_overrunFrames.store(0, std::memory_order_relaxed);
 
-  // Initialize Device (we do this here to ensure fresh start)
-  if (ma_device_init(NULL, &m_deviceConfig, &m_device) != MA_SUCCESS) {
-    ma_encoder_uninit(&m_encoder);
-    throw std::runtime_error("Failed to initialize capture device.");
+  if (!ownDevice) {
+    m_isRecording = true; // feed() takes frames from now on
+    FlightRecorder::record("device.start", "rate", m_deviceConfig.sampleRate, "preRollFrames", (int64_t)preRoll.size());
+    return;
   }
 
-  if (ma_device_start(&m_device) != MA_SUCCESS) {
-    ma_device_uninit(&m_device);
-    ma_encoder_uninit(&m_encoder);
-    throw std::runtime_error("Failed to start capture device.");
+  {
+    TRACE_SCOPE("Recorder::deviceStart");
+    // Initialize Device (we do this here to ensure fresh start)
+    ma_result result = ma_device_init(NULL, &m_deviceConfig, &m_device);
+    if (result != MA_SUCCESS) {
+      FlightRecorder::record("device.initFailed", "result", result);
+      ma_encoder_uninit(&m_encoder);
+      throw std::runtime_error("Failed to initialize capture device.");
+    }
+
+    result = ma_device_start(&m_device);
+    if (result != MA_SUCCESS) {
+      FlightRecorder::record("device.startFailed", "result", result);
+      ma_device_uninit(&m_device);
+      ma_encoder_uninit(&m_encoder);
+      throw std::runtime_error("Failed to start capture device.");
+    }
   }
 
   m_isRecording = true;
   m_isInitialized = true;
+  FlightRecorder::record("device.start", "rate", m_deviceConfig.sampleRate, "preRollFrames", (int64_t)preRoll.size());
 }
 
 inline void Recorder::stop() {
@@ -215,8 +354,10 @@ inline void Recorder::stop() {
   }
   
   if (m_isRecording) {
-    ma_encoder_uninit(&m_encoder);
+    // An external stream must have stopped feeding us by now
     m_isRecording = false;
+    ma_encoder_uninit(&m_encoder);
+    FlightRecorder::record("device.stop", "overrunFrames", (int64_t)getOverrunFrames());
   }
 }
 
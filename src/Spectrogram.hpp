@@ -0,0 +1,284 @@
+#ifndef VOICECLI_SRC_SPECTROGRAM_HPP
+#define VOICECLI_SRC_SPECTROGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Turns the capture stream into spectrogram columns for the status window.
+ *
+ * The audio callback pushes samples into a single-producer/single-consumer
+ * ring; the render thread pulls them and computes one column per hop, always
+ * 64 columns per second of audio whatever the sample rate. Each column is a
+ * Hann-windowed radix-2 FFT whose bins are folded into Rows log-spaced bands
+ * (60 Hz up to 8 kHz) and scaled to 0-255 over -90..-10 dBFS.
+ *
+ * CPU time is bounded: at most a fixed number of columns is computed per call,
+ * and older audio beyond that is skipped. The time spent is measured so the
+ * cost can be reported.
+ */
+class Spectrogram {
+public:
+  static constexpr int Rows = 64;
+  static constexpr int ColumnsPerSecond = 64;
+
+  /**
+   * @brief Sets up the FFT for a capture rate.
+   * @param sampleRate Capture rate of the samples that will be pushed.
+   */
+  explicit Spectrogram(unsigned int sampleRate);
+
+  // Disable copying
+  Spectrogram(const Spectrogram&) = delete;
+  Spectrogram& operator=(const Spectrogram&) = delete;
+
+  /**
+   * @brief Computes the columns for the audio pushed since the last call.
+   *
+   * Consumer side; call from one thread only.
+   *
+   * @param out Receives Rows bytes per column, lowest band first.
+   * @param maxColumns Upper bound on columns computed; older audio beyond it is skipped.
+   * @return The number of columns appended.
+   */
+  size_t compute(std::vector<uint8_t>& out, size_t maxColumns);
+
+  /**
+   * @brief Adds captured samples. Producer side: real-time safe, never blocks.
+   *
+   * Samples that do not fit are dropped.
+   */
+  void push(const float* samples, size_t count);
+
+  /**
+   * @brief Describes the cost since the last reset(): columns, time per column, share of one core.
+   */
+  std::string report() const;
+
+  /**
+   * @brief Drops buffered audio and restarts the cost statistics. Consumer side.
+   */
+  void reset();
+
+private:
+  static void butterflies(float* __restrict ar, float* __restrict ai, float* __restrict br, float* __restrict bi,
+                          const float* __restrict wr, const float* __restrict wi, size_t half);
+  void fft();
+
+  size_t m_fftSize;
+  size_t m_hop;
+  std::vector<float> m_ring;         // Power-of-two sample ring
+  std::atomic<size_t> m_writePos;    // Total samples pushed
+  std::atomic<size_t> m_readPos;     // Total samples consumed
+  std::vector<float> m_history;      // Last m_fftSize samples
+  std::vector<float> m_window;       // Hann window
+  std::vector<float> m_re;           // FFT work arrays (split real / imaginary)
+  std::vector<float> m_im;
+  std::vector<float> m_twiddleRe;    // Per-stage twiddles, stage `half` at [half - 1, 2 * half - 1)
+  std::vector<float> m_twiddleIm;
+  std::vector<uint32_t> m_bitReverse;
+  std::vector<int> m_bandStart;      // First FFT bin of each row (Rows + 1 entries)
+  std::chrono::steady_clock::time_point m_since;
+  std::chrono::nanoseconds m_busy;
+  size_t m_columns;
+  size_t m_skipped;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline Spectrogram::Spectrogram(unsigned int sampleRate)
+    : m_writePos(0), m_readPos(0), m_busy(0), m_columns(0), m_skipped(0) {
+  m_hop = std::max<size_t>(1, sampleRate / ColumnsPerSecond);
+  m_fftSize = 256;
+  while (m_fftSize < 2 * m_hop && m_fftSize < 2048) m_fftSize *= 2;
+  while (m_fftSize < m_hop) m_fftSize *= 2; // Above 131 kHz the window must still hold a whole hop
+
+  size_t ringSize = 1;
+  while (ringSize < (size_t)sampleRate) ringSize *= 2; // About a second of headroom
+  m_ring.assign(ringSize, 0.0f);
+  m_history.assign(m_fftSize, 0.0f);
+  m_re.resize(m_fftSize);
+  m_im.resize(m_fftSize);
+
+  const double pi = std::acos(-1.0);
+  m_window.resize(m_fftSize);
+  for (size_t i = 0; i < m_fftSize; ++i) {
+    m_window[i] = (float)(0.5 - 0.5 * std::cos(2.0 * pi * i / (m_fftSize - 1)));
+  }
+  // Contiguous per stage so the butterfly loop reads them with unit stride
+  m_twiddleRe.resize(m_fftSize - 1);
+  m_twiddleIm.resize(m_fftSize - 1);
+  for (size_t half = 1; half < m_fftSize; half *= 2) {
+    for (size_t k = 0; k < half; ++k) {
+      m_twiddleRe[half - 1 + k] = (float)std::cos(pi * k / half);
+      m_twiddleIm[half - 1 + k] = (float)-std::sin(pi * k / half);
+    }
+  }
+  int bits = 0;
+  while (((size_t)1 << bits) < m_fftSize) ++bits;
+  m_bitReverse.resize(m_fftSize);
+  for (size_t i = 0; i < m_fftSize; ++i) {
+    uint32_t r = 0;
+    for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+    m_bitReverse[i] = r;
+  }
+
+  // Log-spaced bands; each gets at least one bin
+  double top = std::min(8000.0, sampleRate / 2.0);
+  double binHz = (double)sampleRate / m_fftSize;
+  m_bandStart.resize(Rows + 1);
+  for (int row = 0; row <= Rows; ++row) {
+    double hz = 60.0 * std::pow(top / 60.0, (double)row / Rows);
+    m_bandStart[row] = std::clamp((int)(hz / binHz), 1, (int)m_fftSize / 2);
+  }
+  for (int row = 1; row <= Rows; ++row) {
+    m_bandStart[row] = std::max(m_bandStart[row], m_bandStart[row - 1] + 1);
+  }
+  m_bandStart[Rows] = std::min(m_bandStart[Rows], (int)m_fftSize / 2 + 1);
+  reset();
+}
+
+/**
+ * @brief One radix-2 group: `half` butterflies between a and b with twiddles w.
+ *
+ * Kept as a function so the restrict qualifiers on the parameters survive
+ * inlining and the loop vectorizes without runtime alias checks.
+ */
+inline void Spectrogram::butterflies(float* __restrict ar, float* __restrict ai, float* __restrict br,
+                                     float* __restrict bi, const float* __restrict wr, const float* __restrict wi,
+                                     size_t half) {
+  for (size_t k = 0; k < half; ++k) {
+    float tr = br[k] * wr[k] - bi[k] * wi[k];
+    float ti = br[k] * wi[k] + bi[k] * wr[k];
+    br[k] = ar[k] - tr;
+    bi[k] = ai[k] - ti;
+    ar[k] += tr;
+    ai[k] += ti;
+  }
+}
+
+inline size_t Spectrogram::compute(std::vector<uint8_t>& out, size_t maxColumns) {
+  auto start = std::chrono::steady_clock::now();
+  size_t read = m_readPos.load(std::memory_order_relaxed);
+  size_t available = m_writePos.load(std::memory_order_acquire) - read;
+  size_t columns = available / m_hop;
+
+  // Over budget: skip straight to the newest audio that still fits
+  if (columns > maxColumns) {
+    size_t skip = columns - maxColumns;
+    read += skip * m_hop;
+    m_skipped += skip;
+    columns = maxColumns;
+  }
+
+  const size_t mask = m_ring.size() - 1;
+  const float scale = 2.0f / m_fftSize;
+  for (size_t c = 0; c < columns; ++c) {
+    // Slide the history by one hop and append the new samples
+    std::copy(m_history.begin() + m_hop, m_history.end(), m_history.begin());
+    for (size_t i = 0; i < m_hop; ++i) {
+      m_history[m_fftSize - m_hop + i] = m_ring[(read + i) & mask];
+    }
+    read += m_hop;
+
+    for (size_t i = 0; i < m_fftSize; ++i) {
+      size_t j = m_bitReverse[i];
+      m_re[j] = m_history[i] * m_window[i];
+      m_im[j] = 0.0f;
+    }
+    fft();
+
+    for (int row = 0; row < Rows; ++row) {
+      float peak = 0.0f;
+      for (int bin = m_bandStart[row]; bin < m_bandStart[row + 1]; ++bin) {
+        peak = std::max(peak, m_re[bin] * m_re[bin] + m_im[bin] * m_im[bin]);
+      }
+      float db = 10.0f * std::log10(peak * scale * scale + 1e-12f);
+      float v = std::clamp((db + 90.0f) / 80.0f, 0.0f, 1.0f);
+      out.push_back((uint8_t)(v * 255.0f));
+    }
+  }
+  m_readPos.store(read, std::memory_order_release);
+
+  m_columns += columns;
+  m_busy += std::chrono::steady_clock::now() - start;
+  return columns;
+}
+
+/**
+ * @brief In-place iterative radix-2 FFT on m_re/m_im (input already bit-reversed).
+ *
+ * The first two stages are fused into one radix-4 pass, since their groups
+ * are too short to vectorize. Every later stage reads its twiddles with unit
+ * stride from its own slice of the table, so the -O3 build vectorizes the
+ * butterfly loop (checked with -fopt-info-vec).
+ */
+inline void Spectrogram::fft() {
+  const size_t n = m_fftSize;
+  float* re = m_re.data();
+  float* im = m_im.data();
+  for (size_t group = 0; group < n; group += 4) {
+    float* __restrict r = re + group;
+    float* __restrict i = im + group;
+    float r0 = r[0] + r[1], i0 = i[0] + i[1];
+    float r1 = r[0] - r[1], i1 = i[0] - i[1];
+    float r2 = r[2] + r[3], i2 = i[2] + i[3];
+    float r3 = r[2] - r[3], i3 = i[2] - i[3];
+    r[0] = r0 + r2;
+    i[0] = i0 + i2;
+    r[2] = r0 - r2;
+    i[2] = i0 - i2;
+    r[1] = r1 + i3; // Twiddle -i
+    i[1] = i1 - r3;
+    r[3] = r1 - i3;
+    i[3] = i1 + r3;
+  }
+  for (size_t half = 4; half < n; half *= 2) {
+    const float* wr = m_twiddleRe.data() + half - 1;
+    const float* wi = m_twiddleIm.data() + half - 1;
+    for (size_t group = 0; group < n; group += 2 * half) {
+      butterflies(re + group, im + group, re + group + half, im + group + half, wr, wi, half);
+    }
+  }
+}
+
+inline void Spectrogram::push(const float* samples, size_t count) {
+  size_t write = m_writePos.load(std::memory_order_relaxed);
+  size_t read = m_readPos.load(std::memory_order_acquire);
+  size_t space = m_ring.size() - (write - read);
+  count = std::min(count, space);
+
+  const size_t mask = m_ring.size() - 1;
+  for (size_t i = 0; i < count; ++i) {
+    m_ring[(write + i) & mask] = samples[i];
+  }
+  m_writePos.store(write + count, std::memory_order_release);
+}
+
+inline std::string Spectrogram::report() const {
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_since).count();
+  double busy = std::chrono::duration<double>(m_busy).count();
+  return std::format("{} columns ({} skipped over budget), {:.1f} us per column, {:.3f}% of one core "
+                     "(FFT size {}, hop {})",
+                     m_columns, m_skipped, m_columns ? busy * 1e6 / m_columns : 0.0,
+                     wall > 0 ? 100.0 * busy / wall : 0.0, m_fftSize, m_hop);
+}
+
+inline void Spectrogram::reset() {
+  m_readPos.store(m_writePos.load(std::memory_order_acquire), std::memory_order_release);
+  std::fill(m_history.begin(), m_history.end(), 0.0f);
+  m_since = std::chrono::steady_clock::now();
+  m_busy = std::chrono::nanoseconds(0);
+  m_columns = 0;
+  m_skipped = 0;
+}
+
+#endif // VOICECLI_SRC_SPECTROGRAM_HPP
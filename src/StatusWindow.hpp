@@ -4,32 +4,71 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <string>
+#include <unordered_map>
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
 #include <vector>
 
+#include "Logger.hpp"
+#include "Spectrogram.hpp"
+#include "X11Connection.hpp"
+
 /**
  * @brief Manages the status display window using X11.
  * 
  * Displays real-time status information, available commands, and a volume meter.
  * Handles centering on screen and staying always on top.
+ *
+ * Meant to be created once: fonts, colors and the window itself are set up a
+ * single time, and the window is withdrawn between sessions and mapped again
+ * for the next one without waiting for the window manager.
+ *
+ * Frames are drawn into an offscreen back buffer. Only the text lines that
+ * changed and the meter (when its fill changed) are redrawn, and the damaged
+ * span is presented with a single copy, so the window never flickers through
+ * a cleared state. The meter gradient is rendered once into a pixmap, and the
+ * level-to-width mapping (dB scale) is a lookup table.
+ *
+ * Optionally a scrolling spectrogram strip sits under the meter. It is kept
+ * client-side as an XImage and sent with one image request per update; on a
+ * local display the image lives in MIT-SHM shared memory, so the server reads
+ * the pixels directly instead of receiving them over the socket.
  */
 class StatusWindow {
 public:
   /**
-   * @brief Initializes X11 connection and pre-allocates resources (fonts, colors).
+   * @brief Attaches to the shared UI connection and pre-allocates resources (fonts, colors).
+   * @param spectrogram Whether to add the spectrogram strip (makes the window taller).
    * @throws std::runtime_error if X11 connection fails.
    */
-  StatusWindow();
+  explicit StatusWindow(bool spectrogram = false);
   ~StatusWindow();
 
   /**
-   * @brief Creates and displays the status window centered on screen.
+   * @brief Maps the status window centered on screen, creating it on first use.
+   *
+   * Returns without waiting for the window manager; the window is drawn and
+   * focused when its MapNotify arrives (see checkForInput()).
+   *
    * @param initialText The text to display initially.
+   * @param takeFocus If false, the window is marked as not accepting input focus,
+   *        so the application being dictated into keeps the keyboard.
+   * @param triggerTime When the session was triggered; the time until the window
+   *        is visible is logged (default: now).
    */
-  void show(const std::string& initialText);
+  void show(const std::string& initialText, bool takeFocus = true,
+            std::chrono::steady_clock::time_point triggerTime = {});
 
   /**
    * @brief Updates the text and volume meter display.
@@ -38,6 +77,17 @@ public:
    */
   void updateText(const std::string& text, float volumeLevel = -1.0f);
 
+  /**
+   * @brief Scrolls new columns into the spectrogram strip and shows it.
+   *
+   * Does nothing when the window has no strip. While the server still reads
+   * the shared image, columns are held back and drawn with the next call.
+   *
+   * @param columns Spectrogram::Rows intensities (0-255) per column, lowest band first.
+   * @param count Number of columns.
+   */
+  void drawSpectrogram(const uint8_t* columns, size_t count);
+
   /**
    * @brief Changes the window background color.
    * @param colorName X11 color name (e.g., "white", "red", "yellow").
@@ -52,10 +102,17 @@ public:
   bool checkForInput(char& outKey);
 
   /**
-   * @brief Hides and destroys the status window.
+   * @brief Withdraws the status window; the next show() maps it again.
    */
   void close();
 
+  /**
+   * @brief Returns the meter fill width in pixels for a level (-1 if the meter is hidden).
+   *
+   * Two levels with the same fill draw the same meter.
+   */
+  int meterFill(float volumeLevel) const;
+
   /**
    * @brief Blocks until a key is pressed in the window.
    * @return The character of the key pressed.
@@ -63,27 +120,74 @@ public:
   char waitForKey();
 
 private:
+  static constexpr int MeterWidth = 360;   // Window width (400) - 2 * margin (20)
+  static constexpr int MeterHeight = 15;
+  static constexpr int MeterLutSize = 4096;
+  static constexpr int WindowWidth = 400;
+  static constexpr int WindowHeight = 350;       // Without the spectrogram strip
+  static constexpr int SpectrumWidth = MeterWidth;
+  static constexpr int SpectrumHeight = Spectrogram::Rows;
+
+  unsigned long allocColor(const std::string& colorName);
+  void createSpectrumImage();
+  void createWindow();
+  void destroySpectrumImage();
+  void handleEvent(const XEvent& e);
+  void logFrameStats();
+  void present(int top, int bottom);
+  void putSpectrum();
+  void renderMeterGradient();
+
   Display* m_display;
   Window m_window;
   GC m_gc;
   int m_screen;
+  int m_x;                                           // Centered position, set when the window is created
+  int m_y;
   bool m_visible;
+  bool m_mapPending;                                 // Mapped, MapNotify not seen yet
+  bool m_focusOnMap;
+  std::chrono::steady_clock::time_point m_triggerTime;
   unsigned long m_currentBg;
   unsigned long m_fgColor;
   std::vector<unsigned long> m_gradientColors;
   std::string m_lastColorName;
   XFontStruct* m_font;
+  Pixmap m_backBuffer;                               // Offscreen copy of the window contents
+  std::vector<std::string> m_lines;                  // Text lines currently in the back buffer
+  int m_meterShown;                                  // Fill width in the back buffer, -1 = no meter
+  bool m_fullRedraw;                                 // Next frame repaints everything
+  std::unordered_map<std::string, unsigned long> m_palette; // Background colors by name
+  Pixmap m_meterGradient;                            // Full-width gradient, copied from per frame
+  std::array<uint16_t, MeterLutSize> m_meterFill;    // Quantized level -> filled width in pixels
+  unsigned long m_frames;                            // Frames and X requests since show()
+  unsigned long m_frameRequests;
+  unsigned long m_meterRequests;
+  unsigned long m_columnRequests;                    // What per-column drawing would have sent
+  int m_height;                                      // Window height, including the strip
+  XImage* m_spectrumImage;                           // Strip contents, nullptr = no strip
+  XShmSegmentInfo m_shmInfo;
+  bool m_shmAttached;                                // m_spectrumImage lives in shared memory
+  int m_shmCompletion;                               // ShmCompletion event type
+  int m_shmPending;                                  // Shared puts the server has not finished
+  std::vector<uint8_t> m_pendingColumns;             // Held back while the image is in use
+  std::array<unsigned long, 256> m_heatPixels;       // Intensity -> pixel value
+  unsigned long m_spectrumPuts;                      // Image requests since show()
+  unsigned long m_spectrumColumns;
 };
 
 // -----------------------------------------------------------------------------
 // Inline Implementations
 // -----------------------------------------------------------------------------
 
-inline StatusWindow::StatusWindow() : m_display(nullptr), m_visible(false), m_font(nullptr) {
-  m_display = XOpenDisplay(NULL);
-  if (!m_display) {
-    throw std::runtime_error("Failed to open X Display for Status Window.");
-  }
+inline StatusWindow::StatusWindow(bool spectrogram)
+    : m_display(nullptr), m_window(0), m_x(0), m_y(0), m_visible(false), m_mapPending(false),
+      m_focusOnMap(false), m_font(nullptr), m_backBuffer(0), m_meterShown(-1),
+      m_fullRedraw(true), m_meterGradient(0), m_frames(0),
+      m_frameRequests(0), m_meterRequests(0), m_columnRequests(0), m_height(WindowHeight),
+      m_spectrumImage(nullptr), m_shmInfo{}, m_shmAttached(false), m_shmCompletion(-1),
+      m_shmPending(0), m_heatPixels{}, m_spectrumPuts(0), m_spectrumColumns(0) {
+  m_display = X11Connection::instance().display(X11Connection::Channel::UI);
   m_screen = DefaultScreen(m_display);
   m_currentBg = WhitePixel(m_display, m_screen);
   m_fgColor = BlackPixel(m_display, m_screen);
@@ -140,193 +244,501 @@ inline StatusWindow::StatusWindow() : m_display(nullptr), m_visible(false), m_fo
       // Fallback if nothing found (rare)
       std::cerr << "Warning: Could not load any preferred font." << std::endl;
   }
+
+  // Background palette, allocated once instead of on every color change
+  for (const char* name : { "white", "yellow", "red" }) {
+      m_palette[name] = allocColor(name);
+  }
+
+  if (spectrogram) {
+      createSpectrumImage();
+      if (m_spectrumImage) m_height = WindowHeight + SpectrumHeight;
+  }
+
+  // Back buffer and the GC drawing into it; both outlive any one window
+  m_backBuffer = XCreatePixmap(m_display, DefaultRootWindow(m_display), WindowWidth, m_height,
+                               DefaultDepth(m_display, m_screen));
+  m_gc = XCreateGC(m_display, m_backBuffer, 0, 0);
+  if (m_font) {
+      XSetFont(m_display, m_gc, m_font->fid);
+  }
+
+  // Meter fill per level on a logarithmic scale: -40dB (0%) to 0dB (100%)
+  for (int i = 0; i < MeterLutSize; ++i) {
+      float level = (float)i / (float)(MeterLutSize - 1);
+      float db = 20.0f * std::log10(level + 1e-9f);
+      float pct = std::clamp((db + 40.0f) / 40.0f, 0.0f, 1.0f);
+      m_meterFill[i] = (uint16_t)(MeterWidth * pct);
+  }
+  renderMeterGradient();
 }
 
 inline StatusWindow::~StatusWindow() {
   close();
+  if (m_window) {
+      XDestroyWindow(m_display, m_window);
+  }
   if (m_font) {
       XFreeFont(m_display, m_font);
   }
-  if (m_display) {
-    XCloseDisplay(m_display);
+  if (m_meterGradient) {
+      XFreePixmap(m_display, m_meterGradient);
   }
+  destroySpectrumImage();
+  XFreeGC(m_display, m_gc);
+  XFreePixmap(m_display, m_backBuffer);
+  // The connection outlives us, so give back what it would have freed on close
+  Colormap colormap = DefaultColormap(m_display, m_screen);
+  XFreeColors(m_display, colormap, m_gradientColors.data(), (int)m_gradientColors.size(), 0);
+  std::vector<unsigned long> palette;
+  for (const auto& [name, pixel] : m_palette) palette.push_back(pixel);
+  XFreeColors(m_display, colormap, palette.data(), (int)palette.size(), 0);
+  XFlush(m_display);
 }
 
-inline void StatusWindow::setBackgroundColor(const std::string& colorName) {
-  if (!m_visible) return;
-  if (colorName == m_lastColorName) return;
-
+/**
+ * @brief Allocates a named color, falling back to white.
+ */
+inline unsigned long StatusWindow::allocColor(const std::string& colorName) {
   XColor color;
   Colormap colormap = DefaultColormap(m_display, m_screen);
   if (XParseColor(m_display, colormap, colorName.c_str(), &color) &&
       XAllocColor(m_display, colormap, &color)) {
-    m_currentBg = color.pixel;
-    XSetWindowBackground(m_display, m_window, m_currentBg);
-    // XClearWindow(m_display, m_window); // updateText will handle clearing
-    m_lastColorName = colorName;
+    return color.pixel;
   }
+  return WhitePixel(m_display, m_screen);
 }
 
-inline void StatusWindow::show(const std::string& initialText) {
-  if (m_visible) return;
+/**
+ * @brief Creates the strip image, in shared memory when the display is local.
+ *
+ * Leaves m_spectrumImage null (no strip) on visuals whose pixel layout is not
+ * TrueColor, since the pixels are composed client-side.
+ */
+inline void StatusWindow::createSpectrumImage() {
+  Visual* visual = DefaultVisual(m_display, m_screen);
+  int depth = DefaultDepth(m_display, m_screen);
+  if (visual->c_class != TrueColor) {
+      Logger::instance().error("StatusWindow: Spectrogram needs a TrueColor visual; disabled.");
+      return;
+  }
 
-  m_currentBg = WhitePixel(m_display, m_screen); // Reset to white
-  m_fgColor = BlackPixel(m_display, m_screen);
+  // Heat map: black -> blue -> red -> yellow -> white, composed from the visual's masks
+  auto channel = [](double v, unsigned long mask) {
+      if (!mask) return 0UL;
+      int shift = 0;
+      while (!((mask >> shift) & 1)) ++shift;
+      unsigned long max = mask >> shift;
+      return ((unsigned long)(std::clamp(v, 0.0, 1.0) * max + 0.5) << shift) & mask;
+  };
+  for (int i = 0; i < 256; ++i) {
+      double t = i / 255.0;
+      double r = std::clamp(t * 3.0 - 1.0, 0.0, 1.0);
+      double g = std::clamp(t * 3.0 - 2.0, 0.0, 1.0);
+      double b = t < 1.0 / 3.0 ? t * 3.0 : std::clamp(2.0 - t * 3.0, 0.0, 1.0) + g;
+      m_heatPixels[i] = channel(r, visual->red_mask) | channel(g, visual->green_mask) |
+                        channel(b, visual->blue_mask);
+  }
 
+  // Shared memory only works when the server runs on this machine
+  std::string name = DisplayString(m_display);
+  bool local = !name.empty() && (name[0] == ':' || name.rfind("unix:", 0) == 0);
+  if (local && XShmQueryExtension(m_display)) {
+      m_spectrumImage = XShmCreateImage(m_display, visual, depth, ZPixmap, nullptr, &m_shmInfo,
+                                        SpectrumWidth, SpectrumHeight);
+      if (m_spectrumImage) {
+          m_shmInfo.shmid = shmget(IPC_PRIVATE, m_spectrumImage->bytes_per_line * m_spectrumImage->height,
+                                   IPC_CREAT | 0600);
+          m_shmInfo.shmaddr = (m_shmInfo.shmid >= 0) ? (char*)shmat(m_shmInfo.shmid, nullptr, 0) : (char*)-1;
+          if (m_shmInfo.shmaddr != (char*)-1) {
+              m_spectrumImage->data = m_shmInfo.shmaddr;
+              m_shmInfo.readOnly = False;
+              m_shmAttached = XShmAttach(m_display, &m_shmInfo);
+              XSync(m_display, False);
+          }
+          // The segment goes away with its last user, even if we crash
+          if (m_shmInfo.shmid >= 0) shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+          if (!m_shmAttached) {
+              if (m_shmInfo.shmaddr != (char*)-1) shmdt(m_shmInfo.shmaddr);
+              m_spectrumImage->data = nullptr;
+              XDestroyImage(m_spectrumImage);
+              m_spectrumImage = nullptr;
+          }
+      }
+      m_shmCompletion = XShmGetEventBase(m_display) + ShmCompletion;
+  }
+
+  if (!m_spectrumImage) {
+      // Plain image: the pixels travel in the request
+      m_spectrumImage = XCreateImage(m_display, visual, depth, ZPixmap, 0, nullptr,
+                                     SpectrumWidth, SpectrumHeight, 32, 0);
+      if (!m_spectrumImage) return;
+      m_spectrumImage->data = (char*)malloc(m_spectrumImage->bytes_per_line * m_spectrumImage->height);
+  }
+  Logger::instance().log(std::format("StatusWindow: Spectrogram strip via {}.",
+                                     m_shmAttached ? "MIT-SHM" : "XPutImage"));
+}
+
+/**
+ * @brief Creates the (unmapped) window, centered on screen.
+ */
+inline void StatusWindow::createWindow() {
   // Screen dimensions for centering
   int screenWidth = DisplayWidth(m_display, m_screen);
   int screenHeight = DisplayHeight(m_display, m_screen);
-  int winW = 400;
-  int winH = 350;
-  int x = (screenWidth - winW) / 2;
-  int y = (screenHeight - winH) / 2;
+  int winW = WindowWidth;
+  int winH = m_height;
+  m_x = (screenWidth - winW) / 2;
+  m_y = (screenHeight - winH) / 2;
 
   m_window = XCreateSimpleWindow(m_display, DefaultRootWindow(m_display), 
-                                 x, y, winW, winH, 
+                                 m_x, m_y, winW, winH, 
                                  1, m_fgColor, m_currentBg);
 
+  // Contents come from the back buffer; a server-side clear would only flash
+  XSetWindowBackgroundPixmap(m_display, m_window, None);
+
   // Set Window Title
   XStoreName(m_display, m_window, "VoiceCLI Status");
 
   // Inform Window Manager of position
   XSizeHints hints;
   hints.flags = PPosition | PSize;
-  hints.x = x;
-  hints.y = y;
+  hints.x = m_x;
+  hints.y = m_y;
   hints.width = winW;
   hints.height = winH;
   XSetWMNormalHints(m_display, m_window, &hints);
 
   // Always On Top
-  Atom wmState = XInternAtom(m_display, "_NET_WM_STATE", False);
-  Atom wmStateAbove = XInternAtom(m_display, "_NET_WM_STATE_ABOVE", False);
+  Atom wmState = X11Connection::instance().atom("_NET_WM_STATE");
+  Atom wmStateAbove = X11Connection::instance().atom("_NET_WM_STATE_ABOVE");
   XChangeProperty(m_display, m_window, wmState, XA_ATOM, 32, PropModeReplace, 
                   (unsigned char*)&wmStateAbove, 1);
 
   // Select Inputs
   XSelectInput(m_display, m_window, ExposureMask | KeyPressMask | StructureNotifyMask);
+}
 
-  // Map (Show) Window
-  XMapWindow(m_display, m_window);
-  m_visible = true;
+/**
+ * @brief Frees the strip image and its shared memory.
+ */
+inline void StatusWindow::destroySpectrumImage() {
+  if (!m_spectrumImage) return;
+  if (m_shmAttached) {
+      XShmDetach(m_display, &m_shmInfo);
+      XSync(m_display, False);
+      shmdt(m_shmInfo.shmaddr);
+      m_spectrumImage->data = nullptr;
+      m_shmAttached = false;
+  }
+  XDestroyImage(m_spectrumImage);
+  m_spectrumImage = nullptr;
+}
+
+inline void StatusWindow::drawSpectrogram(const uint8_t* columns, size_t count) {
+  if (!m_visible || !m_spectrumImage) return;
 
-  // Wait for MapNotify
+  // Columns that arrived while the server was still reading the image go first
+  m_pendingColumns.insert(m_pendingColumns.end(), columns, columns + count * SpectrumHeight);
+  size_t keep = (size_t)SpectrumWidth * SpectrumHeight;
+  if (m_pendingColumns.size() > keep) {
+      m_pendingColumns.erase(m_pendingColumns.begin(), m_pendingColumns.end() - keep);
+  }
   XEvent e;
-  while (1) {
-    XNextEvent(m_display, &e);
-    if (e.type == MapNotify) break;
+  while (m_shmPending > 0 && XCheckTypedEvent(m_display, m_shmCompletion, &e)) {
+      handleEvent(e);
   }
-  
-  // Create Graphics Context
-  m_gc = XCreateGC(m_display, m_window, 0, 0);
-  XSetForeground(m_display, m_gc, m_fgColor);
-  XSetBackground(m_display, m_gc, m_currentBg);
-  
-  if (m_font) {
-      XSetFont(m_display, m_gc, m_font->fid);
+  if (m_shmPending > 0 || m_pendingColumns.empty()) return;
+
+  // Scroll left and write the new columns at the right edge, lowest band at the bottom
+  int n = (int)(m_pendingColumns.size() / SpectrumHeight);
+  int bytesPerPixel = m_spectrumImage->bits_per_pixel / 8;
+  for (int y = 0; y < SpectrumHeight; ++y) {
+      char* row = m_spectrumImage->data + y * m_spectrumImage->bytes_per_line;
+      if (n < SpectrumWidth) {
+          std::memmove(row, row + n * bytesPerPixel, (size_t)(SpectrumWidth - n) * bytesPerPixel);
+      }
+  }
+  for (int c = 0; c < n; ++c) {
+      const uint8_t* column = m_pendingColumns.data() + (size_t)c * SpectrumHeight;
+      int x = SpectrumWidth - n + c;
+      for (int row = 0; row < SpectrumHeight; ++row) {
+          XPutPixel(m_spectrumImage, x, SpectrumHeight - 1 - row, m_heatPixels[column[row]]);
+      }
   }
+  m_spectrumColumns += n;
+  m_pendingColumns.clear();
+
+  putSpectrum();
+  int top = WindowHeight - 15;
+  present(top, top + SpectrumHeight);
+  XFlush(m_display);
+}
+
+/**
+ * @brief Handles the non-key events: repaints, the end of mapping and finished shared puts.
+ */
+inline void StatusWindow::handleEvent(const XEvent& e) {
+  if (m_shmAttached && e.type == m_shmCompletion) {
+    m_shmPending = std::max(0, m_shmPending - 1);
+  } else if (e.type == Expose) {
+    present(e.xexpose.y, e.xexpose.y + e.xexpose.height);
+  } else if (e.type == MapNotify && e.xmap.window == m_window && m_mapPending) {
+    m_mapPending = false;
+    // Final move to be sure (some WMs need this after map)
+    XMoveWindow(m_display, m_window, m_x, m_y);
+    if (m_focusOnMap) {
+      XSetInputFocus(m_display, m_window, RevertToParent, CurrentTime);
+    }
+    present(0, m_height);
+    auto latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_triggerTime);
+    Logger::instance().log(std::format("StatusWindow: trigger-to-visible {:.1f} ms.", latency.count()));
+  }
+}
+
+/**
+ * @brief Logs the X requests per frame of the session that just ended.
+ */
+inline void StatusWindow::logFrameStats() {
+  if (m_frames == 0) return;
+  Logger::instance().log(std::format(
+      "StatusWindow: {} frames, {:.1f} X requests per frame; meter {:.1f} (per-column drawing: {:.1f}).",
+      m_frames, (double)m_frameRequests / m_frames, (double)m_meterRequests / m_frames,
+      (double)m_columnRequests / m_frames));
+  if (m_spectrumImage && m_spectrumPuts > 0) {
+    Logger::instance().log(std::format("StatusWindow: Spectrogram {} columns in {} {} puts.", m_spectrumColumns,
+                                       m_spectrumPuts, m_shmAttached ? "shared" : "plain"));
+  }
+  m_frames = m_frameRequests = m_meterRequests = m_columnRequests = 0;
+  m_spectrumPuts = m_spectrumColumns = 0;
+}
+
+/**
+ * @brief Copies a horizontal span of the back buffer to the window.
+ */
+inline void StatusWindow::present(int top, int bottom) {
+  top = std::max(top, 0);
+  bottom = std::min(bottom, m_height);
+  if (bottom <= top) return;
+  XCopyArea(m_display, m_backBuffer, m_window, m_gc, 0, top, WindowWidth, bottom - top, 0, top);
+}
+
+/**
+ * @brief Sends the strip image into the back buffer (below the meter).
+ */
+inline void StatusWindow::putSpectrum() {
+  int x = 20;
+  int y = WindowHeight - 15;
+  if (m_shmAttached) {
+      // The server reads the segment later; ShmCompletion says when it is safe to write again
+      XShmPutImage(m_display, m_backBuffer, m_gc, m_spectrumImage, 0, 0, x, y, SpectrumWidth, SpectrumHeight, True);
+      ++m_shmPending;
+  } else {
+      XPutImage(m_display, m_backBuffer, m_gc, m_spectrumImage, 0, 0, x, y, SpectrumWidth, SpectrumHeight);
+  }
+  ++m_spectrumPuts;
+}
+
+/**
+ * @brief Draws the full meter gradient once into a pixmap.
+ *
+ * Each column's color represents the dB level at that point of the bar:
+ * green up to 75% (-10dB), then through yellow to red at the end.
+ */
+inline void StatusWindow::renderMeterGradient() {
+  Window root = DefaultRootWindow(m_display);
+  m_meterGradient = XCreatePixmap(m_display, root, MeterWidth, MeterHeight - 1,
+                                  DefaultDepth(m_display, m_screen));
+  GC gc = XCreateGC(m_display, m_meterGradient, 0, 0);
+
+  for (int x = 0; x < MeterWidth; ++x) {
+      float pos = (float)x / (float)MeterWidth; // Position in bar (0.0 - 1.0)
+      int idx;
+      if (pos < 0.75f) {
+          // Interpolate 0 to 0.5 in gradient ramp (Green to Yellow)
+          idx = (int)(pos / 0.75f * 31.0f);
+      } else {
+          // Interpolate 0.5 to 1.0 in gradient ramp (Yellow to Red)
+          idx = 32 + (int)((pos - 0.75f) / 0.25f * 31.0f);
+      }
+      idx = std::clamp(idx, 0, 63);
+
+      XSetForeground(m_display, gc, m_gradientColors[idx]);
+      XDrawLine(m_display, m_meterGradient, gc, x, 0, x, MeterHeight - 2);
+  }
+  XFreeGC(m_display, gc);
+}
+
+inline void StatusWindow::setBackgroundColor(const std::string& colorName) {
+  if (!m_visible) return;
+  if (colorName == m_lastColorName) return;
+
+  auto it = m_palette.find(colorName);
+  if (it == m_palette.end()) {
+    it = m_palette.emplace(colorName, allocColor(colorName)).first; // Kept for next time
+  }
+  m_currentBg = it->second;
+  m_lastColorName = colorName;
+  m_fullRedraw = true;
+}
+
+inline void StatusWindow::show(const std::string& initialText, bool takeFocus,
+                               std::chrono::steady_clock::time_point triggerTime) {
+  if (m_visible) return;
+  m_triggerTime = (triggerTime == std::chrono::steady_clock::time_point{}) ? std::chrono::steady_clock::now()
+                                                                            : triggerTime;
+
+  m_currentBg = m_palette["white"]; // Reset to white
+  m_lastColorName = "white";
+  m_fgColor = BlackPixel(m_display, m_screen);
+  m_fullRedraw = true;
+
+  if (m_spectrumImage) {
+    // Each session starts with an empty strip (close() waited for the server to finish reading it)
+    m_pendingColumns.clear();
+    for (int y = 0; y < SpectrumHeight; ++y) {
+      for (int x = 0; x < SpectrumWidth; ++x) XPutPixel(m_spectrumImage, x, y, m_heatPixels[0]);
+    }
+  }
+
+  if (!m_window) {
+    createWindow();
+  }
+
+  // Keys typed into the window as the last session ended must not reach this one
+  while (XPending(m_display) > 0) {
+    XEvent e;
+    XNextEvent(m_display, &e);
+  }
+
+  // Ask the window manager for the keyboard focus, or not to hand it to us
+  XWMHints wmHints;
+  wmHints.flags = InputHint;
+  wmHints.input = takeFocus ? True : False;
+  XSetWMHints(m_display, m_window, &wmHints);
+
+  // Map (Show) Window; the rest happens on MapNotify
+  XMapRaised(m_display, m_window);
+  m_visible = true;
+  m_mapPending = true;
+  m_focusOnMap = takeFocus;
 
-  // Final move to be sure (some WMs need this after map)
-  XMoveWindow(m_display, m_window, x, y);
-  XRaiseWindow(m_display, m_window);
-  XSetInputFocus(m_display, m_window, RevertToParent, CurrentTime);
-  
   updateText(initialText);
 }
 
 inline void StatusWindow::updateText(const std::string& text, float volumeLevel) {
   if (!m_visible) return;
 
-  XSetForeground(m_display, m_gc, m_fgColor);
-  XSetBackground(m_display, m_gc, m_currentBg);
-
-  // Clear area (naive redraw)
-  XClearWindow(m_display, m_window);
+  // Pick up the end of mapping and repaints even if nobody reads keys; keys stay queued
+  XEvent e;
+  while (XCheckTypedWindowEvent(m_display, m_window, MapNotify, &e) ||
+         XCheckTypedWindowEvent(m_display, m_window, Expose, &e)) {
+    handleEvent(e);
+  }
+  unsigned long frameStart = XNextRequest(m_display);
 
   int lineHeight = 20;
+  int ascent = 15;
   if (m_font) {
       lineHeight = m_font->ascent + m_font->descent + 2;
+      ascent = m_font->ascent;
   }
 
-  int y = 30; // Start margin
+  int y = 30; // Start margin (baseline of the first line)
   // If font is large, start lower to fit ascender
   if (m_font) y = m_font->ascent + 10;
 
-  std::string line;
+  std::vector<std::string> lines;
   std::string::size_type pos = 0;
   std::string::size_type prev = 0;
-  
-  std::string s = text;
-  while ((pos = s.find('\n', prev)) != std::string::npos) {
-      line = s.substr(prev, pos - prev);
-      XDrawString(m_display, m_window, m_gc, 20, y, line.c_str(), line.length());
-      y += lineHeight;
+  while ((pos = text.find('\n', prev)) != std::string::npos) {
+      lines.push_back(text.substr(prev, pos - prev));
       prev = pos + 1;
   }
-  line = s.substr(prev);
-  if (!line.empty()) {
-      XDrawString(m_display, m_window, m_gc, 20, y, line.c_str(), line.length());
+  lines.push_back(text.substr(prev));
+
+  // Damage is tracked as one full-width span, presented with a single copy
+  int damageTop = m_height;
+  int damageBottom = 0;
+  auto damage = [&](int top, int bottom) {
+      damageTop = std::min(damageTop, top);
+      damageBottom = std::max(damageBottom, bottom);
+  };
+
+  if (m_fullRedraw) {
+      XSetForeground(m_display, m_gc, m_currentBg);
+      XFillRectangle(m_display, m_backBuffer, m_gc, 0, 0, WindowWidth, m_height);
+      if (m_spectrumImage) putSpectrum(); // Only reads the image, so fine while a put is pending
+      m_lines.clear();
+      m_meterShown = -1;
+      m_fullRedraw = false;
+      damage(0, m_height);
   }
 
-  // Draw Volume Bar
-  if (volumeLevel >= 0.0f) {
-      int barX = 20;
-      int winH = 350; // Updated height
-      int barH = 15;
-      int barY = winH - 40; // 40px from bottom
-      int barW = 360; // winW (400) - 2*margin(20)
-      
-      // Draw border
-      XSetForeground(m_display, m_gc, m_fgColor);
-      XDrawRectangle(m_display, m_window, m_gc, barX, barY, barW, barH);
-      
-      // Calculate dB and percentage
-      // Range: -40dB (0%) to 0dB (100%)
-      float db = 20.0f * std::log10(volumeLevel + 1e-9f);
-      float floor = -40.0f;
-      float pct = (db - floor) / (0.0f - floor);
-      pct = std::clamp(pct, 0.0f, 1.0f);
-      
-      int fillW = (int)(barW * pct);
-      
-      // Draw Gradient Fill
-      if (fillW > 0) {
-          for (int x = 0; x < fillW; ++x) {
-              float pos = (float)x / (float)barW; // Position in bar (0.0 - 1.0)
-              
-              // We want the COLOR to represent the dB level at that point in the bar.
-              // Mapping:
-              // 0.0 -> Green
-              // 0.75 (-10dB) -> Yellow
-              // 0.925 (-3dB) -> Red
-              
-              int idx;
-              if (pos < 0.75f) {
-                  // Interpolate 0 to 0.5 in gradient ramp (Green to Yellow)
-                  float t = pos / 0.75f;
-                  idx = (int)(t * 31.0f);
-              } else {
-                  // Interpolate 0.5 to 1.0 in gradient ramp (Yellow to Red)
-                  float t = (pos - 0.75f) / 0.25f;
-                  idx = 32 + (int)(t * 31.0f);
-              }
-              
-              if (idx < 0) idx = 0;
-              if (idx > 63) idx = 63;
-              
-              XSetForeground(m_display, m_gc, m_gradientColors[idx]);
-              XDrawLine(m_display, m_window, m_gc, barX + x, barY + 1, barX + x, barY + barH - 1);
+  // Redraw only the lines that changed (and clear the ones that went away)
+  for (size_t i = 0; i < std::max(lines.size(), m_lines.size()); ++i) {
+      bool had = i < m_lines.size();
+      bool has = i < lines.size();
+      if (had && has && lines[i] == m_lines[i]) continue;
+      if (!had && has && lines[i].empty()) continue;
+
+      int baseline = y + (int)i * lineHeight;
+      int top = baseline - ascent;
+      XSetForeground(m_display, m_gc, m_currentBg);
+      XFillRectangle(m_display, m_backBuffer, m_gc, 0, top, WindowWidth, lineHeight);
+      if (has && !lines[i].empty()) {
+          XSetForeground(m_display, m_gc, m_fgColor);
+          XDrawString(m_display, m_backBuffer, m_gc, 20, baseline, lines[i].c_str(), lines[i].length());
+      }
+      damage(top, top + lineHeight);
+  }
+  m_lines = std::move(lines);
+
+  // Draw Volume Bar when its fill changed
+  int barX = 20;
+  int barY = WindowHeight - 40; // 40px from bottom
+  int fillW = meterFill(volumeLevel);
+  if (fillW != m_meterShown) {
+      unsigned long meterStart = XNextRequest(m_display);
+      XSetForeground(m_display, m_gc, m_currentBg);
+      XFillRectangle(m_display, m_backBuffer, m_gc, barX, barY, MeterWidth + 1, MeterHeight + 1);
+      if (fillW >= 0) {
+          // Draw border
+          XSetForeground(m_display, m_gc, m_fgColor);
+          XDrawRectangle(m_display, m_backBuffer, m_gc, barX, barY, MeterWidth, MeterHeight);
+          // Reveal the prerendered gradient up to the fill width
+          if (fillW > 0) {
+              XCopyArea(m_display, m_meterGradient, m_backBuffer, m_gc, 0, 0, fillW, MeterHeight - 1,
+                        barX, barY + 1);
           }
       }
+      m_meterShown = fillW;
+      damage(barY, barY + MeterHeight + 1);
+      m_meterRequests += XNextRequest(m_display) - meterStart;
   }
-  
-  XFlush(m_display);
+  if (fillW >= 0) {
+      m_columnRequests += 2 + 2 * (unsigned long)fillW; // Border + a color and a line per column
+  }
+
+  present(damageTop, damageBottom);
+  ++m_frames;
+  m_frameRequests += XNextRequest(m_display) - frameStart;
+
+  if (damageBottom > damageTop) XFlush(m_display);
+}
+
+inline int StatusWindow::meterFill(float volumeLevel) const {
+  if (volumeLevel < 0.0f) return -1;
+  int idx = (int)(std::clamp(volumeLevel, 0.0f, 1.0f) * (MeterLutSize - 1) + 0.5f);
+  return m_meterFill[idx];
 }
 
 inline bool StatusWindow::checkForInput(char& outKey) {
   if (!m_visible) return false;
   
   bool keyFound = false;
+  bool handled = false;
   
   // Drain the event queue to prevent buildup of ignored events (Expose, etc.)
   while (XPending(m_display) > 0) {
@@ -341,8 +753,12 @@ inline bool StatusWindow::checkForInput(char& outKey) {
             outKey = buffer[0];
             keyFound = true;
         }
+    } else {
+        handleEvent(e);
+        handled = true;
     }
   }
+  if (handled) XFlush(m_display);
   return keyFound;
 }
 
@@ -359,6 +775,9 @@ inline char StatusWindow::waitForKey() {
         if (count == 1) {
             return buffer[0];
         }
+    } else {
+        handleEvent(e);
+        XFlush(m_display);
     }
   }
   return 0;
@@ -366,9 +785,16 @@ inline char StatusWindow::waitForKey() {
 
 inline void StatusWindow::close() {
   if (m_visible) {
-    XFreeGC(m_display, m_gc);
-    XDestroyWindow(m_display, m_window);
+    logFrameStats();
+    XWithdrawWindow(m_display, m_window, m_screen);
+    if (m_shmPending > 0) {
+      // Completions may be dropped while withdrawn; once synced, every put is done
+      XSync(m_display, False);
+      m_shmPending = 0;
+    }
+    XFlush(m_display);
     m_visible = false;
+    m_mapPending = false;
   }
 }
 
@@ -0,0 +1,192 @@
+#ifndef VOICECLI_SRC_STREAMCOMMITTER_HPP
+#define VOICECLI_SRC_STREAMCOMMITTER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Transcriber.hpp"
+
+/**
+ * @brief Transcribes committed audio segments in the background, in order.
+ *
+ * Used by streaming sessions: the recording loop hands over each segment once
+ * it is final (ended by a pause) and keeps only the uncommitted tail. A single
+ * worker owns the transcriber's default state for the whole session, so
+ * segments finish in the order they were spoken. Finished text is handed, in
+ * the same order, to a delivery callback on a second thread, so a slow paste
+ * neither delays the next transcription nor stops the session loop from
+ * draining the recorder. Delivery waits while the session holds it back.
+ */
+class StreamCommitter {
+public:
+  /**
+   * @brief Starts the worker and delivery threads.
+   * @param transcriber The transcriber to use; its default state must not be used elsewhere
+   *        until the committer is destroyed.
+   * @param deliver Called on the delivery thread with each segment's text as transcribed
+   *        (may be empty for a silent segment).
+   */
+  StreamCommitter(Transcriber& transcriber, std::function<void(const std::string&)> deliver);
+  ~StreamCommitter();
+
+  // Disable copying
+  StreamCommitter(const StreamCommitter&) = delete;
+  StreamCommitter& operator=(const StreamCommitter&) = delete;
+
+  /**
+   * @brief Drops queued segments and undelivered text; the one being transcribed finishes but
+   *        is discarded, a delivery in progress completes.
+   */
+  void cancel();
+
+  /**
+   * @brief Queues a final segment for transcription.
+   * @param pcm16k 16kHz mono samples of the segment.
+   */
+  void commit(std::vector<float> pcm16k);
+
+  /**
+   * @brief Returns true while segments are queued, being transcribed or waiting for delivery.
+   */
+  bool busy();
+
+  /**
+   * @brief Holds delivery back while set, e.g. while the user is typing; a delivery in progress completes.
+   */
+  void hold(bool held);
+
+private:
+  void deliverer();
+  void worker();
+
+  Transcriber& m_transcriber;
+  std::function<void(const std::string&)> m_deliver;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::vector<float>> m_jobs;
+  std::deque<std::string> m_done;
+  bool m_working;
+  bool m_delivering;
+  bool m_held;
+  bool m_cancelled;
+  bool m_stop;
+  std::thread m_thread;
+  std::thread m_deliverThread;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline StreamCommitter::StreamCommitter(Transcriber& transcriber, std::function<void(const std::string&)> deliver)
+    : m_transcriber(transcriber), m_deliver(std::move(deliver)), m_working(false), m_delivering(false),
+      m_held(false), m_cancelled(false), m_stop(false) {
+  m_thread = std::thread(&StreamCommitter::worker, this);
+  m_deliverThread = std::thread(&StreamCommitter::deliverer, this);
+}
+
+inline StreamCommitter::~StreamCommitter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_jobs.clear();
+    m_done.clear();
+  }
+  m_cv.notify_all();
+  if (m_thread.joinable()) m_thread.join();
+  if (m_deliverThread.joinable()) m_deliverThread.join();
+}
+
+inline bool StreamCommitter::busy() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_working || m_delivering || !m_jobs.empty() || !m_done.empty();
+}
+
+inline void StreamCommitter::cancel() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_jobs.clear();
+  m_done.clear();
+  m_cancelled = true;
+}
+
+inline void StreamCommitter::commit(std::vector<float> pcm16k) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(pcm16k));
+  }
+  m_cv.notify_all();
+}
+
+/**
+ * @brief Delivery thread: hands finished text to the callback, in order, whenever it is not held back.
+ */
+inline void StreamCommitter::deliverer() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this] { return m_stop || (!m_held && !m_done.empty()); });
+    if (m_stop) return;
+
+    std::string text = std::move(m_done.front());
+    m_done.pop_front();
+    m_delivering = true;
+    lock.unlock();
+
+    try {
+      m_deliver(text);
+    } catch (const std::exception& e) {
+      Logger::instance().error(std::format("Stream: Segment delivery failed: {}", e.what()));
+    }
+
+    lock.lock();
+    m_delivering = false;
+  }
+}
+
+inline void StreamCommitter::hold(bool held) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_held == held) return;
+    m_held = held;
+  }
+  m_cv.notify_all();
+}
+
+inline void StreamCommitter::worker() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+    if (m_stop) return;
+
+    std::vector<float> pcm = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    m_working = true;
+    m_cancelled = false;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    std::string text;
+    try {
+      text = m_transcriber.transcribe(pcm);
+    } catch (const std::exception& e) {
+      Logger::instance().error(std::format("Stream: Segment transcription failed: {}", e.what()));
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    Logger::instance().log(std::format("Stream: {:.1f}s segment transcribed in {} ms.",
+                                       pcm.size() / 16000.0, ms.count()));
+
+    lock.lock();
+    m_working = false;
+    if (!m_cancelled) m_done.push_back(std::move(text));
+    m_cv.notify_all();
+  }
+}
+
+#endif // VOICECLI_SRC_STREAMCOMMITTER_HPP
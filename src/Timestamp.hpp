@@ -0,0 +1,94 @@
+#ifndef VOICECLI_SRC_TIMESTAMP_HPP
+#define VOICECLI_SRC_TIMESTAMP_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+
+/**
+ * @brief Formats wall-clock times as "YYYY-MM-DD HH:MM:SS.mmm" in local time.
+ *
+ * Built for the log path: each thread keeps the formatted seconds prefix and
+ * only rewrites the milliseconds until the second changes. The local UTC
+ * offset is looked up with localtime_r (which takes libc's timezone lock) once
+ * per quarter hour per thread, the granularity of DST transitions; in between,
+ * the calendar fields come from plain arithmetic, so no global lock is taken.
+ */
+class Timestamp {
+public:
+  static constexpr size_t Length = 23; // "2024-01-31 12:34:56.789"
+
+  /**
+   * @brief Writes the timestamp for a time point.
+   * @param time The time to format.
+   * @param out Receives exactly Length characters (not terminated).
+   */
+  static void format(std::chrono::system_clock::time_point time, char* out);
+
+private:
+  struct Cache {
+    int64_t second = std::numeric_limits<int64_t>::min();      // Unix second the prefix is for
+    int64_t offsetUntil = std::numeric_limits<int64_t>::min(); // Offset is valid before this second
+    long offset = 0;                                           // Seconds east of UTC
+    char prefix[20] = {};                                      // "YYYY-MM-DD HH:MM:SS."
+  };
+
+  static void digits(char* out, unsigned value, int count);
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline void Timestamp::digits(char* out, unsigned value, int count) {
+  for (int i = count - 1; i >= 0; --i) {
+    out[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+}
+
+inline void Timestamp::format(std::chrono::system_clock::time_point time, char* out) {
+  thread_local Cache cache;
+  using namespace std::chrono;
+
+  auto ms = duration_cast<milliseconds>(time.time_since_epoch()).count();
+  int64_t second = (ms >= 0) ? ms / 1000 : (ms - 999) / 1000;
+  unsigned millis = (unsigned)(ms - second * 1000);
+
+  if (second != cache.second) {
+    if (second >= cache.offsetUntil) {
+      std::time_t t = (std::time_t)second;
+      std::tm tm;
+      localtime_r(&t, &tm);
+      cache.offset = tm.tm_gmtoff;
+      cache.offsetUntil = second - (second % 900 + 900) % 900 + 900;
+    }
+
+    // Civil date of the local day, without going through libc
+    int64_t local = second + cache.offset;
+    int64_t dayIndex = (local >= 0) ? local / 86400 : (local - 86399) / 86400;
+    year_month_day date{ sys_days{ days{ dayIndex } } };
+    unsigned daySeconds = (unsigned)(local - dayIndex * 86400);
+
+    char* p = cache.prefix;
+    digits(p, (unsigned)(int)date.year(), 4);
+    p[4] = '-';
+    digits(p + 5, (unsigned)date.month(), 2);
+    p[7] = '-';
+    digits(p + 8, (unsigned)date.day(), 2);
+    p[10] = ' ';
+    digits(p + 11, daySeconds / 3600, 2);
+    p[13] = ':';
+    digits(p + 14, daySeconds / 60 % 60, 2);
+    p[16] = ':';
+    digits(p + 17, daySeconds % 60, 2);
+    p[19] = '.';
+    cache.second = second;
+  }
+
+  for (size_t i = 0; i < sizeof(cache.prefix); ++i) out[i] = cache.prefix[i];
+  digits(out + sizeof(cache.prefix), millis, 3);
+}
+
+#endif // VOICECLI_SRC_TIMESTAMP_HPP
@@ -0,0 +1,361 @@
+#ifndef VOICECLI_SRC_TRACE_HPP
+#define VOICECLI_SRC_TRACE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <deque>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Records timed spans per thread and writes them as Chrome trace events.
+ *
+ * Spans (TRACE_SCOPE) and instant events (TRACE_INSTANT) go into a fixed ring
+ * owned by the recording thread, overwriting the oldest entries, so recording
+ * never blocks or allocates after a thread's first event. A ring outlives its
+ * thread so the trace still shows it, but once more than KeepExited threads
+ * have exited, the oldest one's ring is handed to the next new thread; per-session
+ * worker threads therefore don't grow memory without bound. The file is written
+ * in the Chrome `trace_event` JSON format (open it in chrome://tracing or
+ * Perfetto) at exit and whenever the process receives SIGUSR1.
+ *
+ * While tracing is off, a span costs one relaxed atomic load.
+ */
+class Trace {
+public:
+  /**
+   * @brief Access the singleton instance.
+   */
+  static Trace& instance();
+
+  /**
+   * @brief Returns true while spans are being recorded.
+   */
+  static bool enabled();
+
+  /**
+   * @brief Current time on the trace clock, in nanoseconds.
+   */
+  static int64_t now();
+
+  /**
+   * @brief Records a finished span on the calling thread.
+   * @param name A string literal (only the pointer is stored).
+   */
+  void complete(const char* name, int64_t startNs, int64_t endNs);
+
+  /**
+   * @brief Writes everything recorded so far to the trace file.
+   * @return false if tracing is off or the file cannot be written.
+   */
+  bool dump();
+
+  /**
+   * @brief Records an instant event on the calling thread.
+   * @param name A string literal (only the pointer is stored).
+   */
+  void instant(const char* name);
+
+  /**
+   * @brief Turns recording on; the trace goes to path at exit and on SIGUSR1.
+   * @throws std::runtime_error If the signal pipe cannot be created.
+   */
+  void start(const std::string& path);
+
+private:
+  static constexpr size_t RingSize = 8192; // Events per thread, power of two
+  static constexpr size_t KeepExited = 8;  // Rings of exited threads kept before being reused
+
+  struct Event {
+    std::atomic<const char*> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> duration; // < 0 = instant event
+  };
+
+  struct Ring {
+    long tid;
+    std::string threadName;
+    std::atomic<uint64_t> head{ 0 }; // Events ever written
+    Event events[RingSize];
+  };
+
+  Trace();
+  ~Trace();
+
+  // Disable copying
+  Trace(const Trace&) = delete;
+  Trace& operator=(const Trace&) = delete;
+
+  static void onSignal(int sig);
+  void record(const char* name, int64_t startNs, int64_t duration);
+  void retire(Ring* ring);
+  Ring& ring();
+  void signalLoop();
+
+  static std::atomic<bool> s_enabled;
+  static int s_signalPipe[2];
+
+  std::mutex m_mutex;                      // Guards the rings' owners and m_path; not taken when recording
+  std::vector<std::unique_ptr<Ring>> m_rings; // Kept after their thread exits
+  std::deque<Ring*> m_exited;              // Rings of exited threads, oldest first
+  std::string m_path;
+  int64_t m_origin;                        // Trace clock value written as ts 0
+  std::atomic<bool> m_stop;
+  std::thread m_signalThread;
+};
+
+/**
+ * @brief Times the enclosing scope as a span when tracing is on.
+ */
+class TraceScope {
+public:
+  explicit TraceScope(const char* name) : m_name(name), m_start(Trace::enabled() ? Trace::now() : 0) {}
+  ~TraceScope() {
+    if (m_start) Trace::instance().complete(m_name, m_start, Trace::now());
+  }
+
+  // Disable copying
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  const char* m_name;
+  int64_t m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/** @brief Records the rest of the enclosing scope as a span named by a string literal. */
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+/** @brief Records a point in time named by a string literal. */
+#define TRACE_INSTANT(name)                                                                                            \
+  do {                                                                                                                 \
+    if (Trace::enabled()) Trace::instance().instant(name);                                                            \
+  } while (0)
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline std::atomic<bool> Trace::s_enabled{ false };
+inline int Trace::s_signalPipe[2] = { -1, -1 };
+
+inline Trace::Trace() : m_origin(now()), m_stop(false) {
+}
+
+inline Trace::~Trace() {
+  if (enabled()) {
+    dump();
+    s_enabled.store(false);
+  }
+  m_stop.store(true);
+  if (s_signalPipe[1] >= 0) {
+    char wake = 0;
+    ssize_t written = write(s_signalPipe[1], &wake, 1);
+    (void)written;
+  }
+  if (m_signalThread.joinable()) m_signalThread.join();
+}
+
+inline void Trace::complete(const char* name, int64_t startNs, int64_t endNs) {
+  record(name, startNs, endNs - startNs);
+}
+
+inline bool Trace::dump() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_path.empty()) return false;
+
+  std::ofstream file(m_path, std::ios::trunc);
+  if (!file) {
+    Logger::instance().error(std::format("Trace: Cannot write {}.", m_path));
+    return false;
+  }
+
+  auto escape = [](const std::string& s) {
+    std::string out;
+    for (char c : s) {
+      if (c == '"' || c == '\\') out += '\\';
+      if ((unsigned char)c >= 0x20) out += c;
+    }
+    return out;
+  };
+
+  long pid = getpid();
+  size_t written = 0;
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << std::format("{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"tid\":0,\"args\":{{\"name\":\"VoiceCLI\"}}}}",
+                      pid);
+  for (const auto& ring : m_rings) {
+    file << std::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                        pid, ring->tid, escape(ring->threadName));
+
+    // The owner keeps writing; keep only entries it cannot have overwritten while we read
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t first = head > RingSize ? head - RingSize : 0;
+    std::vector<std::tuple<const char*, int64_t, int64_t>> events;
+    for (uint64_t i = first; i < head; ++i) {
+      const Event& e = ring->events[i & (RingSize - 1)];
+      events.emplace_back(e.name.load(std::memory_order_relaxed), e.start.load(std::memory_order_relaxed),
+                          e.duration.load(std::memory_order_relaxed));
+    }
+    uint64_t after = ring->head.load(std::memory_order_acquire);
+    uint64_t valid = after >= RingSize ? after - RingSize + 1 : 0; // Slot `after` may be mid-write
+    for (uint64_t i = first; i < head; ++i) {
+      if (i < valid) continue;
+      auto [name, start, duration] = events[i - first];
+      if (!name) continue;
+      double ts = (start - m_origin) / 1000.0;
+      if (duration < 0) {
+        file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"voicecli\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f},"
+                            "\"pid\":{},\"tid\":{}}}",
+                            escape(name), ts, pid, ring->tid);
+      } else {
+        file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"voicecli\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},"
+                            "\"pid\":{},\"tid\":{}}}",
+                            escape(name), ts, duration / 1000.0, pid, ring->tid);
+      }
+      ++written;
+    }
+  }
+  file << "\n]}\n";
+  file.close();
+  Logger::instance().log(std::format("Trace: {} events from {} thread(s) written to {}.", written, m_rings.size(),
+                                     m_path));
+  return true;
+}
+
+inline bool Trace::enabled() {
+  return s_enabled.load(std::memory_order_relaxed);
+}
+
+inline void Trace::instant(const char* name) {
+  record(name, now(), -1);
+}
+
+inline Trace& Trace::instance() {
+  static Trace instance;
+  return instance;
+}
+
+inline int64_t Trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief SIGUSR1 handler: only wakes the dump thread (write() is async-signal-safe).
+ */
+inline void Trace::onSignal(int sig) {
+  (void)sig;
+  int saved = errno;
+  char wake = 1;
+  ssize_t written = write(s_signalPipe[1], &wake, 1);
+  (void)written;
+  errno = saved;
+}
+
+/**
+ * @brief Appends an event to the calling thread's ring. Only the owner writes a ring.
+ */
+inline void Trace::record(const char* name, int64_t startNs, int64_t duration) {
+  Ring& r = ring();
+  uint64_t head = r.head.load(std::memory_order_relaxed);
+  Event& e = r.events[head & (RingSize - 1)];
+  e.name.store(name, std::memory_order_relaxed);
+  e.start.store(startNs, std::memory_order_relaxed);
+  e.duration.store(duration, std::memory_order_relaxed);
+  r.head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Called as a thread exits: its ring stays in the trace until a new thread reuses it.
+ */
+inline void Trace::retire(Ring* ring) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_exited.push_back(ring);
+}
+
+/**
+ * @brief Returns the calling thread's ring, registering it on first use.
+ */
+inline Trace::Ring& Trace::ring() {
+  struct Owner {
+    Ring* ring = nullptr;
+    ~Owner() {
+      if (ring) Trace::instance().retire(ring);
+    }
+  };
+  thread_local Owner t_owner;
+  if (!t_owner.ring) {
+    long tid = (long)syscall(SYS_gettid);
+    char name[32] = "";
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_exited.size() > KeepExited) {
+      // Dumps hold the mutex too, so the old thread's events can be dropped here
+      t_owner.ring = m_exited.front();
+      m_exited.pop_front();
+      t_owner.ring->head.store(0, std::memory_order_relaxed);
+    } else {
+      m_rings.push_back(std::make_unique<Ring>());
+      t_owner.ring = m_rings.back().get();
+    }
+    t_owner.ring->tid = tid;
+    t_owner.ring->threadName = std::format("{} ({})", name, tid);
+  }
+  return *t_owner.ring;
+}
+
+/**
+ * @brief Dump thread: writes the trace each time SIGUSR1 arrives.
+ */
+inline void Trace::signalLoop() {
+  pollfd pfd = { s_signalPipe[0], POLLIN, 0 };
+  while (!m_stop.load()) {
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return;
+    char drain[16];
+    bool requested = false;
+    ssize_t n;
+    while ((n = read(s_signalPipe[0], drain, sizeof(drain))) > 0) {
+      for (ssize_t i = 0; i < n; ++i) requested |= drain[i] != 0;
+    }
+    if (requested && !m_stop.load()) dump();
+  }
+}
+
+inline void Trace::start(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+  }
+  if (s_signalPipe[0] < 0) {
+    if (pipe2(s_signalPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+      throw std::runtime_error("Failed to create trace signal pipe.");
+    }
+    m_signalThread = std::thread(&Trace::signalLoop, this);
+    std::signal(SIGUSR1, onSignal);
+  }
+  s_enabled.store(true);
+  Logger::instance().log(std::format("Trace: Recording; written to {} at exit and on SIGUSR1.", path));
+}
+
+#endif // VOICECLI_SRC_TRACE_HPP
@@ -6,9 +6,16 @@
 #include <stdexcept>
 #include <iostream>
 #include <format>
+#include <memory>
+#include <algorithm>
+#include <chrono>
 
 #include "whisper.h"
+#include "CommandGrammar.hpp"
+#include "FlightRecorder.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
 #include "../third_party/miniaudio.h"
 
 // -----------------------------------------------------------------------------
@@ -20,6 +27,7 @@
  * 
  * Handles multi-line log messages by buffering them until a newline or a non-continuation
  * level is encountered. Logs to Logger::error for GGML_LOG_LEVEL_ERROR, otherwise to Logger::log.
+ * The pending buffer is per thread, since batch workers run inference concurrently.
  * 
  * @param level The log level from ggml.
  * @param text The log message part.
@@ -27,8 +35,8 @@
  */
 inline void whisper_log_callback(ggml_log_level level, const char * text, void * user_data) {
     (void)user_data;
-    static std::string buffer;
-    static ggml_log_level last_level = GGML_LOG_LEVEL_INFO;
+    thread_local std::string buffer;
+    thread_local ggml_log_level last_level = GGML_LOG_LEVEL_INFO;
 
     if (level != GGML_LOG_LEVEL_CONT) {
         if (!buffer.empty()) {
@@ -53,15 +61,21 @@ inline void whisper_log_callback(ggml_log_level level, const char * text, void *
  * @brief Handles speech-to-text transcription using the Whisper model.
  * 
  * Manages the Whisper context and performs inference on WAV audio files.
+ * The model weights can be shared by several workers, each running inference
+ * on its own whisper_state (see createState()).
  */
 class Transcriber {
 public:
+  using StatePtr = std::unique_ptr<whisper_state, void (*)(whisper_state*)>;
+
   /**
    * @brief Initializes the Whisper context with a pre-trained model.
    * @param modelPath Path to the ggml-*.bin Whisper model file.
+   * @param withDefaultState If false, only the weights are loaded and every caller
+   *        must bring its own state from createState().
    * @throws std::runtime_error If model loading fails.
    */
-  Transcriber(const std::string& modelPath);
+  Transcriber(const std::string& modelPath, bool withDefaultState = true);
   ~Transcriber();
 
   // Disable copying
@@ -69,30 +83,108 @@ public:
   Transcriber& operator=(const Transcriber&) = delete;
 
   /**
-   * @brief Transcribes a WAV audio file to text.
+   * @brief Allocates an independent inference state over the shared weights.
+   * @return The new state, freed automatically.
+   * @throws std::runtime_error If the state cannot be allocated.
+   */
+  StatePtr createState();
+
+  /**
+   * @brief Decodes an audio file into 16kHz mono float samples.
+   *
+   * Any format miniaudio can decode (WAV, FLAC, MP3) is accepted.
+   *
+   * @param path Path to the audio file.
+   * @return The decoded samples.
+   * @throws std::runtime_error If the file cannot be decoded.
+   */
+  static std::vector<float> loadAudio(const std::string& path);
+
+  /**
+   * @brief Converts mono float samples from an arbitrary rate to 16kHz.
+   * @param pcmf32 The input samples.
+   * @param sampleRate The rate of the input samples.
+   * @return The samples at 16kHz (a copy if already at 16kHz).
+   */
+  static std::vector<float> resampleTo16k(const std::vector<float>& pcmf32, unsigned int sampleRate);
+
+  /**
+   * @brief Transcribes an audio file (WAV, FLAC or MP3) to text.
    * 
    * Loads the audio file using miniaudio, converts to the required 16kHz float format,
    * and runs Whisper inference.
    * 
-   * @param wavPath Path to the input WAV file.
+   * @param wavPath Path to the input audio file.
    * @return The transcribed text string.
    * @throws std::runtime_error If audio loading or inference fails.
    */
   std::string transcribe(const std::string& wavPath);
 
+  /**
+   * @brief Transcribes 16kHz mono samples using the default state.
+   * @throws std::runtime_error If inference fails or there is no default state.
+   */
+  std::string transcribe(const std::vector<float>& pcmf32);
+
+  /**
+   * @brief Transcribes 16kHz mono samples on a caller-owned state.
+   *
+   * Safe to call concurrently from several threads as long as each uses its own state.
+   *
+   * @param pcmf32 The samples to transcribe.
+   * @param state A state obtained from createState().
+   * @param nThreads Inference threads for this call (0 = whisper default).
+   * @throws std::runtime_error If inference fails.
+   */
+  std::string transcribe(const std::vector<float>& pcmf32, whisper_state* state, int nThreads = 0);
+
+  /**
+   * @brief Decodes 16kHz mono samples constrained to a command phrase list.
+   *
+   * Decoding is restricted by the grammar and stops as soon as a phrase is
+   * complete; the result is mapped to the closest phrase's output.
+   *
+   * @param pcmf32 The samples to transcribe.
+   * @param grammar The compiled phrase list.
+   * @return The matched command and its score.
+   * @throws std::runtime_error If inference fails or there is no default state.
+   */
+  CommandMatch transcribeCommand(const std::vector<float>& pcmf32, const CommandGrammar& grammar);
+
+  /**
+   * @brief Quickly transcribes a clip of a few seconds using the default state.
+   *
+   * Shrinks the encoder context to the clip length and caps the number of decoded
+   * tokens, trading accuracy for speed. Intended for keyword spotting.
+   *
+   * @param pcmf32 16kHz mono samples, ideally under 3 seconds.
+   * @param maxTokens Upper bound on decoded tokens.
+   * @throws std::runtime_error If inference fails.
+   */
+  std::string transcribeSnippet(const std::vector<float>& pcmf32, int maxTokens = 8);
+
 private:
+  whisper_full_params makeParams() const;
+  static void finishInference(std::chrono::steady_clock::time_point start, size_t samples);
+
   struct whisper_context* m_ctx;
+  bool m_hasDefaultState;
 };
 
 // -----------------------------------------------------------------------------
 // Inline Implementations
 // -----------------------------------------------------------------------------
 
-inline Transcriber::Transcriber(const std::string& modelPath) : m_ctx(nullptr) {
+inline Transcriber::Transcriber(const std::string& modelPath, bool withDefaultState)
+    : m_ctx(nullptr), m_hasDefaultState(withDefaultState) {
   whisper_log_set(whisper_log_callback, nullptr);
   
   struct whisper_context_params cparams = whisper_context_default_params();
-  m_ctx = whisper_init_from_file_with_params(modelPath.c_str(), cparams);
+  if (withDefaultState) {
+    m_ctx = whisper_init_from_file_with_params(modelPath.c_str(), cparams);
+  } else {
+    m_ctx = whisper_init_from_file_with_params_no_state(modelPath.c_str(), cparams);
+  }
   
   if (m_ctx == nullptr) {
     throw std::runtime_error("Failed to initialize Whisper context. Check model path.");
@@ -105,13 +197,31 @@ inline Transcriber::~Transcriber() {
   }
 }
 
-inline std::string Transcriber::transcribe(const std::string& wavPath) {
-  // 1. Decode WAV file using miniaudio
+inline Transcriber::StatePtr Transcriber::createState() {
+  whisper_state* state = whisper_init_state(m_ctx);
+  if (state == nullptr) {
+    throw std::runtime_error("Failed to allocate Whisper state.");
+  }
+  return StatePtr(state, whisper_free_state);
+}
+
+/**
+ * @brief Records an inference's duration and its speed relative to the 16kHz audio it was given.
+ */
+inline void Transcriber::finishInference(std::chrono::steady_clock::time_point start, size_t samples) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  FlightRecorder::record("inference.done", "ms", (int64_t)(elapsed.count() * 1000), "samples", (int64_t)samples);
+  if (samples == 0) return;
+  Metrics::instance().observe(Metrics::Histogram::RealTimeFactor, elapsed.count() / (samples / 16000.0));
+}
+
+inline std::vector<float> Transcriber::loadAudio(const std::string& path) {
+  TRACE_SCOPE("Transcriber::loadAudio");
   ma_decoder decoder;
   ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, 16000);
   
-  if (ma_decoder_init_file(wavPath.c_str(), &config, &decoder) != MA_SUCCESS) {
-    throw std::runtime_error("Failed to load WAV file: " + wavPath);
+  if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS) {
+    throw std::runtime_error("Failed to load audio file: " + path);
   }
 
   // Calculate total frames
@@ -127,8 +237,11 @@ inline std::string Transcriber::transcribe(const std::string& wavPath) {
   }
   
   ma_decoder_uninit(&decoder);
+  pcmf32.resize(framesRead);
+  return pcmf32;
+}
 
-  // 2. Run Whisper Inference
+inline whisper_full_params Transcriber::makeParams() const {
   whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
   wparams.print_progress   = false;
   wparams.print_special    = false;
@@ -137,12 +250,44 @@ inline std::string Transcriber::transcribe(const std::string& wavPath) {
   wparams.translate        = false;
   wparams.no_context       = true;
   wparams.single_segment   = true; // Treat as one command usually
+  return wparams;
+}
 
-  if (whisper_full(m_ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
-    throw std::runtime_error("Failed to run Whisper inference.");
+inline std::vector<float> Transcriber::resampleTo16k(const std::vector<float>& pcmf32,
+                                                     unsigned int sampleRate) {
+  if (sampleRate == 16000 || pcmf32.empty()) return pcmf32;
+  TRACE_SCOPE("Transcriber::resample");
+
+  ma_uint64 outFrames = ma_convert_frames(NULL, 0, ma_format_f32, 1, 16000, pcmf32.data(),
+                                          pcmf32.size(), ma_format_f32, 1, sampleRate);
+  std::vector<float> out(outFrames);
+  outFrames = ma_convert_frames(out.data(), out.size(), ma_format_f32, 1, 16000, pcmf32.data(),
+                                pcmf32.size(), ma_format_f32, 1, sampleRate);
+  out.resize(outFrames);
+  return out;
+}
+
+inline std::string Transcriber::transcribe(const std::string& wavPath) {
+  return transcribe(loadAudio(wavPath));
+}
+
+inline std::string Transcriber::transcribe(const std::vector<float>& pcmf32) {
+  if (!m_hasDefaultState) {
+    throw std::runtime_error("Transcriber was created without a default state.");
+  }
+
+  TRACE_SCOPE("Transcriber::transcribe");
+  whisper_full_params wparams = makeParams();
+  {
+    TRACE_SCOPE("Transcriber::inference");
+    FlightRecorder::record("inference.start", "samples", (int64_t)pcmf32.size());
+    auto start = std::chrono::steady_clock::now();
+    if (whisper_full(m_ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
+      throw std::runtime_error("Failed to run Whisper inference.");
+    }
+    finishInference(start, pcmf32.size());
   }
 
-  // 3. Collect Output
   std::string result = "";
   const int n_segments = whisper_full_n_segments(m_ctx);
   for (int i = 0; i < n_segments; ++i) {
@@ -153,4 +298,91 @@ inline std::string Transcriber::transcribe(const std::string& wavPath) {
   return result;
 }
 
+inline std::string Transcriber::transcribe(const std::vector<float>& pcmf32, whisper_state* state,
+                                           int nThreads) {
+  TRACE_SCOPE("Transcriber::transcribe");
+  whisper_full_params wparams = makeParams();
+  if (nThreads > 0) wparams.n_threads = nThreads;
+
+  {
+    TRACE_SCOPE("Transcriber::inference");
+    FlightRecorder::record("inference.start", "samples", (int64_t)pcmf32.size());
+    auto start = std::chrono::steady_clock::now();
+    if (whisper_full_with_state(m_ctx, state, wparams, pcmf32.data(), pcmf32.size()) != 0) {
+      throw std::runtime_error("Failed to run Whisper inference.");
+    }
+    finishInference(start, pcmf32.size());
+  }
+
+  std::string result = "";
+  const int n_segments = whisper_full_n_segments_from_state(state);
+  for (int i = 0; i < n_segments; ++i) {
+    result += whisper_full_get_segment_text_from_state(state, i);
+  }
+
+  return result;
+}
+
+inline CommandMatch Transcriber::transcribeCommand(const std::vector<float>& pcmf32,
+                                                   const CommandGrammar& grammar) {
+  if (!m_hasDefaultState) {
+    throw std::runtime_error("Transcriber was created without a default state.");
+  }
+
+  TRACE_SCOPE("Transcriber::transcribeCommand");
+  whisper_full_params wparams = makeParams();
+  grammar.configure(wparams);
+
+  {
+    TRACE_SCOPE("Transcriber::inference");
+    FlightRecorder::record("inference.start", "samples", (int64_t)pcmf32.size());
+    auto start = std::chrono::steady_clock::now();
+    if (whisper_full(m_ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
+      throw std::runtime_error("Failed to run Whisper inference.");
+    }
+    finishInference(start, pcmf32.size());
+  }
+
+  std::string heard = "";
+  float probSum = 0.0f;
+  int probCount = 0;
+  const whisper_token eot = whisper_token_eot(m_ctx);
+  const int n_segments = whisper_full_n_segments(m_ctx);
+  for (int i = 0; i < n_segments; ++i) {
+    heard += whisper_full_get_segment_text(m_ctx, i);
+    const int n_tokens = whisper_full_n_tokens(m_ctx, i);
+    for (int j = 0; j < n_tokens; ++j) {
+      if (whisper_full_get_token_id(m_ctx, i, j) >= eot) continue; // Skip special tokens
+      probSum += whisper_full_get_token_p(m_ctx, i, j);
+      probCount++;
+    }
+  }
+
+  return grammar.match(heard, probCount > 0 ? probSum / probCount : 0.0f);
+}
+
+inline std::string Transcriber::transcribeSnippet(const std::vector<float>& pcmf32, int maxTokens) {
+  if (!m_hasDefaultState) {
+    throw std::runtime_error("Transcriber was created without a default state.");
+  }
+
+  whisper_full_params wparams = makeParams();
+  // The encoder context covers 30s in 1500 positions; only encode what the clip needs.
+  int clipCtx = (int)(pcmf32.size() * 1500 / (30 * 16000)) + 64;
+  wparams.audio_ctx = std::min(clipCtx, 1500);
+  wparams.max_tokens = maxTokens;
+  wparams.no_timestamps = true;
+
+  if (whisper_full(m_ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
+    throw std::runtime_error("Failed to run Whisper inference.");
+  }
+
+  std::string result = "";
+  const int n_segments = whisper_full_n_segments(m_ctx);
+  for (int i = 0; i < n_segments; ++i) {
+    result += whisper_full_get_segment_text(m_ctx, i);
+  }
+  return result;
+}
+
 #endif // VOICECLI_SRC_TRANSCRIBER_HPP
\ No newline at end of file
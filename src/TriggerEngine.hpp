@@ -0,0 +1,370 @@
+#ifndef VOICECLI_SRC_TRIGGERENGINE_HPP
+#define VOICECLI_SRC_TRIGGERENGINE_HPP
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A trigger description bound to an action name.
+ */
+struct TriggerBinding {
+  std::string spec;   // e.g. "Shift Shift", "Ctrl+Alt+Space", "Super hold 300ms"
+  std::string action; // Opaque to the engine; interpreted by the caller
+};
+
+/**
+ * @brief Compiles trigger descriptions into table-driven state machines.
+ *
+ * Description language (tokens separated by spaces, key names case-insensitive):
+ * - A chord is one or more keys joined by '+', e.g. `Ctrl+Alt+Space`. Shift,
+ *   Ctrl/Control, Alt and Super match either side; anything else is an X keysym
+ *   name (`F9`, `space`, `Pause`).
+ * - Several chords form a sequence, e.g. `Shift Shift`. Every chord is pressed
+ *   and fully released before the next, which must start within the tap window.
+ * - `within <n>ms` sets the tap window (default 400ms).
+ * - `hold <n>ms` makes the last chord fire only after being held that long.
+ *
+ * All key names of all bindings share one slot space (at most 64 slots) and a
+ * keycode-to-slot table, so the set of held keys is a bitmask. Each binding is a
+ * transition table indexed by (state, event class); a key event costs one mask
+ * update plus one table lookup per binding, independent of history.
+ */
+class TriggerEngine {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Parses and compiles the bindings.
+   * @param display Display used to map key names to keycodes.
+   * @param bindings The trigger descriptions, in priority order.
+   * @throws std::invalid_argument If a description cannot be parsed or names an unknown key.
+   */
+  TriggerEngine(Display* display, const std::vector<TriggerBinding>& bindings);
+
+  // Disable copying
+  TriggerEngine(const TriggerEngine&) = delete;
+  TriggerEngine& operator=(const TriggerEngine&) = delete;
+
+  /**
+   * @brief Returns a binding by index.
+   */
+  const TriggerBinding& binding(int index) const;
+
+  /**
+   * @brief Returns the earliest pending tap-window or hold deadline, if any.
+   */
+  std::optional<Clock::time_point> nextDeadline() const;
+
+  /**
+   * @brief Feeds one key state change.
+   * @return The index of the binding that fired, or -1.
+   */
+  int onKey(KeyCode code, bool pressed, Clock::time_point now);
+
+  /**
+   * @brief Expires deadlines that have passed; completes hold triggers.
+   * @return The index of the binding that fired, or -1.
+   */
+  int onTimeout(Clock::time_point now);
+
+  /**
+   * @brief Re-seeds the held-key state from an XQueryKeymap bitmap.
+   *
+   * Keys already held must be released before any trigger can start.
+   */
+  void reset(const char* keyMap);
+
+  /**
+   * @brief Returns the number of bindings.
+   */
+  size_t size() const;
+
+private:
+  enum Event : uint8_t { Partial, Complete, Released, Broken, EventCount };
+  enum Effect : uint8_t { NoEffect, ArmWindow, ArmHold, Fire };
+
+  struct Transition {
+    uint8_t next;
+    Effect effect;
+  };
+
+  struct Machine {
+    std::vector<uint64_t> required;                          // Chord mask per state
+    std::vector<std::array<Transition, EventCount>> table;   // [state][event]
+    std::vector<Transition> onDeadline;                      // [state]
+    Clock::duration window;
+    Clock::duration hold;
+    uint8_t state;
+    std::optional<Clock::time_point> deadline;
+  };
+
+  static std::chrono::milliseconds parseDuration(const std::string& token, const std::string& spec);
+
+  int apply(Machine& m, const Transition& t, Clock::time_point now, int index);
+  Event classify(const Machine& m) const;
+  void compile(const TriggerBinding& binding);
+  uint64_t slotMask(const std::string& chord, const std::string& spec);
+  int step(Clock::time_point now);
+
+  Display* m_display;
+  std::vector<TriggerBinding> m_bindings;
+  std::vector<Machine> m_machines;
+  std::vector<std::string> m_slotNames;
+  std::array<uint64_t, 256> m_keySlots;  // Keycode -> slots it belongs to
+  std::array<uint8_t, 64> m_slotDown;    // Held keycodes per slot
+  std::bitset<256> m_down;
+  uint64_t m_downMask;
+  int m_foreignDown;                     // Held keys that belong to no slot
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline TriggerEngine::TriggerEngine(Display* display, const std::vector<TriggerBinding>& bindings)
+    : m_display(display), m_bindings(bindings), m_downMask(0), m_foreignDown(0) {
+  m_keySlots.fill(0);
+  m_slotDown.fill(0);
+  if (m_bindings.empty()) {
+    throw std::invalid_argument("No triggers configured.");
+  }
+  for (const auto& binding : m_bindings) compile(binding);
+}
+
+inline int TriggerEngine::apply(Machine& m, const Transition& t, Clock::time_point now, int index) {
+  // Staying put keeps a running tap window or hold timer
+  if (t.next == m.state && t.effect == NoEffect) return -1;
+
+  m.state = t.next;
+  m.deadline.reset();
+  switch (t.effect) {
+  case ArmWindow:
+    m.deadline = now + m.window;
+    break;
+  case ArmHold:
+    m.deadline = now + m.hold;
+    break;
+  case Fire:
+    // One trigger per gesture: everybody waits for the keys to come up again
+    for (auto& other : m_machines) {
+      other.state = 0;
+      other.deadline.reset();
+    }
+    return index;
+  case NoEffect:
+    break;
+  }
+  return -1;
+}
+
+inline const TriggerBinding& TriggerEngine::binding(int index) const {
+  return m_bindings.at(index);
+}
+
+inline TriggerEngine::Event TriggerEngine::classify(const Machine& m) const {
+  if (m_foreignDown > 0) return Broken;
+  if (m_downMask == 0) return Released;
+  uint64_t req = m.required[m.state];
+  if (m_downMask == req) return Complete;
+  return (m_downMask & ~req) == 0 ? Partial : Broken;
+}
+
+inline void TriggerEngine::compile(const TriggerBinding& binding) {
+  std::istringstream in(binding.spec);
+  std::vector<uint64_t> chords;
+  Machine m;
+  m.window = std::chrono::milliseconds(400);
+  m.hold = Clock::duration::zero();
+  m.state = 0;
+
+  std::string token;
+  while (in >> token) {
+    std::string lower = token;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "hold" || lower == "within") {
+      std::string value;
+      if (!(in >> value)) throw std::invalid_argument("Trigger '" + binding.spec + "': '" + token + "' needs a duration.");
+      auto ms = parseDuration(value, binding.spec);
+      if (lower == "hold") m.hold = ms;
+      else m.window = ms;
+    } else {
+      if (m.hold != Clock::duration::zero()) {
+        throw std::invalid_argument("Trigger '" + binding.spec + "': 'hold' must come last.");
+      }
+      chords.push_back(slotMask(token, binding.spec));
+    }
+  }
+  if (chords.empty()) {
+    throw std::invalid_argument("Trigger '" + binding.spec + "' names no keys.");
+  }
+
+  // States: 0 = rearm (wait for all keys up), then press/release per chord, then hold.
+  const size_t n = chords.size();
+  const uint8_t rearm = 0;
+  auto press = [](size_t i) { return (uint8_t)(1 + 2 * i); };
+  auto release = [](size_t i) { return (uint8_t)(2 + 2 * i); };
+  const uint8_t holdState = (uint8_t)(1 + 2 * n);
+  const bool holds = m.hold != Clock::duration::zero();
+  const size_t states = 2 + 2 * n;
+
+  if (states > 255) throw std::invalid_argument("Trigger '" + binding.spec + "' is too long.");
+  m.required.assign(states, 0);
+  m.table.assign(states, {});
+  m.onDeadline.assign(states, { rearm, NoEffect });
+
+  m.table[rearm] = {{ { rearm, NoEffect }, { rearm, NoEffect }, { press(0), NoEffect }, { rearm, NoEffect } }};
+
+  for (size_t i = 0; i < n; ++i) {
+    bool last = (i + 1 == n);
+    Transition done = !last ? Transition{ release(i), NoEffect }
+                            : (holds ? Transition{ holdState, ArmHold } : Transition{ rearm, Fire });
+
+    m.required[press(i)] = chords[i];
+    m.required[release(i)] = chords[i];
+
+    m.table[press(i)] = {{ { press(i), NoEffect }, done, { press(i), NoEffect }, { rearm, NoEffect } }};
+    if (i > 0) m.onDeadline[press(i)] = { rearm, NoEffect };
+
+    if (!last) {
+      m.table[release(i)] = {{ { release(i), NoEffect }, { release(i), NoEffect }, { press(i + 1), ArmWindow }, { rearm, NoEffect } }};
+    }
+  }
+
+  if (holds) {
+    m.required[holdState] = chords.back();
+    m.table[holdState] = {{ { rearm, NoEffect }, { holdState, NoEffect }, { press(0), NoEffect }, { rearm, NoEffect } }};
+    m.onDeadline[holdState] = { rearm, Fire };
+  }
+
+  m_machines.push_back(std::move(m));
+}
+
+inline std::optional<TriggerEngine::Clock::time_point> TriggerEngine::nextDeadline() const {
+  std::optional<Clock::time_point> earliest;
+  for (const auto& m : m_machines) {
+    if (m.deadline && (!earliest || *m.deadline < *earliest)) earliest = m.deadline;
+  }
+  return earliest;
+}
+
+inline int TriggerEngine::onKey(KeyCode code, bool pressed, Clock::time_point now) {
+  if (m_down.test(code) == pressed) return -1; // Repeat or stale release
+  m_down.set(code, pressed);
+
+  uint64_t slots = m_keySlots[code];
+  if (slots == 0) {
+    m_foreignDown += pressed ? 1 : -1;
+  }
+  for (int slot = 0; slots; ++slot, slots >>= 1) {
+    if (!(slots & 1)) continue;
+    m_slotDown[slot] += pressed ? 1 : -1;
+    if (m_slotDown[slot]) m_downMask |= (1ULL << slot);
+    else m_downMask &= ~(1ULL << slot);
+  }
+  return step(now);
+}
+
+inline int TriggerEngine::onTimeout(Clock::time_point now) {
+  for (size_t i = 0; i < m_machines.size(); ++i) {
+    Machine& m = m_machines[i];
+    if (!m.deadline || *m.deadline > now) continue;
+    int fired = apply(m, m.onDeadline[m.state], now, (int)i);
+    if (fired >= 0) return fired;
+  }
+  // A machine sent back to rearm with no keys held may start over right away
+  return step(now);
+}
+
+inline std::chrono::milliseconds TriggerEngine::parseDuration(const std::string& token, const std::string& spec) {
+  try {
+    size_t used = 0;
+    long value = std::stol(token, &used);
+    std::string unit = token.substr(used);
+    if (value >= 0 && (unit == "ms" || unit.empty())) return std::chrono::milliseconds(value);
+    if (value >= 0 && unit == "s") return std::chrono::seconds(value);
+  } catch (...) {
+  }
+  throw std::invalid_argument("Trigger '" + spec + "': invalid duration '" + token + "'.");
+}
+
+inline void TriggerEngine::reset(const char* keyMap) {
+  m_down.reset();
+  m_slotDown.fill(0);
+  m_downMask = 0;
+  m_foreignDown = 0;
+  for (auto& m : m_machines) {
+    m.state = 0;
+    m.deadline.reset();
+  }
+  for (int code = 0; code < 256; ++code) {
+    if (keyMap[code / 8] & (1 << (code % 8))) onKey((KeyCode)code, true, Clock::now());
+  }
+  step(Clock::now());
+}
+
+inline size_t TriggerEngine::size() const {
+  return m_bindings.size();
+}
+
+inline uint64_t TriggerEngine::slotMask(const std::string& chord, const std::string& spec) {
+  uint64_t mask = 0;
+  std::stringstream keys(chord);
+  std::string name;
+
+  while (std::getline(keys, name, '+')) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "ctrl") lower = "control";
+
+    auto found = std::find(m_slotNames.begin(), m_slotNames.end(), lower);
+    size_t slot = found - m_slotNames.begin();
+    if (found == m_slotNames.end()) {
+      if (m_slotNames.size() == 64) throw std::invalid_argument("Too many distinct trigger keys (max 64).");
+
+      std::vector<KeySym> syms;
+      if (lower == "shift") syms = { XK_Shift_L, XK_Shift_R };
+      else if (lower == "control") syms = { XK_Control_L, XK_Control_R };
+      else if (lower == "alt") syms = { XK_Alt_L, XK_Alt_R };
+      else if (lower == "super") syms = { XK_Super_L, XK_Super_R };
+      else {
+        KeySym sym = XStringToKeysym(name.c_str());
+        if (sym == NoSymbol) sym = XStringToKeysym(lower.c_str());
+        if (sym != NoSymbol) syms = { sym };
+      }
+
+      bool mapped = false;
+      for (KeySym sym : syms) {
+        KeyCode code = XKeysymToKeycode(m_display, sym);
+        if (code == 0) continue;
+        m_keySlots[code] |= (1ULL << slot);
+        mapped = true;
+      }
+      if (!mapped) throw std::invalid_argument("Trigger '" + spec + "': unknown key '" + name + "'.");
+      m_slotNames.push_back(lower);
+    }
+    mask |= (1ULL << slot);
+  }
+  return mask;
+}
+
+inline int TriggerEngine::step(Clock::time_point now) {
+  for (size_t i = 0; i < m_machines.size(); ++i) {
+    Machine& m = m_machines[i];
+    int fired = apply(m, m.table[m.state][classify(m)], now, (int)i);
+    if (fired >= 0) return fired;
+  }
+  return -1;
+}
+
+#endif // VOICECLI_SRC_TRIGGERENGINE_HPP
@@ -0,0 +1,289 @@
+#ifndef VOICECLI_SRC_UIRENDERER_HPP
+#define VOICECLI_SRC_UIRENDERER_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fcntl.h>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "Logger.hpp"
+#include "Spectrogram.hpp"
+#include "StatusWindow.hpp"
+#include "X11Connection.hpp"
+
+/**
+ * @brief One frame's worth of status window state.
+ *
+ * Published whole and never modified afterwards, so the render thread can draw
+ * it without holding any lock.
+ */
+struct UiSnapshot {
+  std::string text;                 // Header, countdown and command list
+  std::string background = "white"; // X11 color name
+  float level = -1.0f;              // Meter level (0.0 to 1.0); < 0 hides the meter
+};
+
+/**
+ * @brief Runs the status window on its own thread.
+ *
+ * The session loop publishes snapshots and reads keys; neither call touches X,
+ * so a slow X server can never stall recording control. The render thread
+ * owns the UI connection. It sleeps in poll() on that connection and a wake
+ * pipe, draws the latest snapshot at most once per frame period, and skips the
+ * frame entirely when the snapshot would draw the same pixels as the last one.
+ *
+ * With a spectrogram attached, the render thread also runs its FFTs, on the
+ * same frame boundaries and with a per-frame column budget, so the analysis
+ * costs at most what the strip can show and never runs on the audio thread.
+ */
+class UiRenderer {
+public:
+  /**
+   * @brief Creates the status window and starts the render thread.
+   * @param fps Maximum frames per second (clamped to 1-60).
+   * @param spectrogram Analyzer fed by the recorder, drawn as a strip (nullptr = no strip).
+   *        Must outlive the renderer.
+   * @throws std::runtime_error If X display cannot be opened or the wake pipe fails.
+   */
+  explicit UiRenderer(unsigned int fps, Spectrogram* spectrogram = nullptr);
+  ~UiRenderer();
+
+  // Disable copying
+  UiRenderer(const UiRenderer&) = delete;
+  UiRenderer& operator=(const UiRenderer&) = delete;
+
+  /**
+   * @brief Withdraws the window (asynchronously) and drops queued keys.
+   */
+  void close();
+
+  /**
+   * @brief Takes the oldest key typed into the window, without blocking.
+   * @return false if no key is queued.
+   */
+  bool pollKey(char& key);
+
+  /**
+   * @brief Replaces the state drawn from the next frame on.
+   */
+  void publish(UiSnapshot snapshot);
+
+  /**
+   * @brief Shows the window (asynchronously) with an initial text.
+   * @param text The text to display initially.
+   * @param takeFocus Whether the window should take the keyboard focus.
+   * @param triggerTime When the session was triggered, for the latency log.
+   */
+  void show(const std::string& text, bool takeFocus, std::chrono::steady_clock::time_point triggerTime);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct ShowRequest {
+    std::string text;
+    bool takeFocus;
+    Clock::time_point triggerTime;
+  };
+
+  bool sameFrame(const UiSnapshot& a, const UiSnapshot& b) const;
+  void run();
+  void wake();
+
+  StatusWindow m_window; // Used only by the render thread once it runs
+  Clock::duration m_framePeriod;
+  Spectrogram* m_spectrogram;
+  size_t m_spectrumBudget; // Columns computed per frame at most
+  std::mutex m_mutex;
+  std::shared_ptr<const UiSnapshot> m_snapshot;
+  std::optional<ShowRequest> m_showRequest;
+  bool m_closeRequest;
+  bool m_stop;
+  std::deque<char> m_keys;
+  int m_wakePipe[2];
+  std::thread m_thread;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline UiRenderer::UiRenderer(unsigned int fps, Spectrogram* spectrogram)
+    : m_window(spectrogram != nullptr),
+      m_framePeriod(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1.0 / std::clamp(fps, 1u, 60u)))),
+      m_spectrogram(spectrogram),
+      // One frame's worth of columns plus one, so jitter is absorbed but a stall is not replayed
+      m_spectrumBudget((size_t)std::ceil((double)Spectrogram::ColumnsPerSecond / std::clamp(fps, 1u, 60u)) + 1),
+      m_closeRequest(false), m_stop(false) {
+  if (pipe2(m_wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    throw std::runtime_error("Failed to create UI wake pipe.");
+  }
+  m_thread = std::thread(&UiRenderer::run, this);
+}
+
+inline UiRenderer::~UiRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  wake();
+  if (m_thread.joinable()) m_thread.join();
+  ::close(m_wakePipe[0]);
+  ::close(m_wakePipe[1]);
+}
+
+inline void UiRenderer::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_showRequest.reset();
+    m_closeRequest = true;
+    m_snapshot.reset();
+    m_keys.clear();
+  }
+  wake();
+}
+
+inline bool UiRenderer::pollKey(char& key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_keys.empty()) return false;
+  key = m_keys.front();
+  m_keys.pop_front();
+  return true;
+}
+
+inline void UiRenderer::publish(UiSnapshot snapshot) {
+  auto frame = std::make_shared<const UiSnapshot>(std::move(snapshot));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_snapshot = std::move(frame);
+  // No wake-up: the render thread picks it up at its next frame
+}
+
+/**
+ * @brief Render thread body.
+ *
+ * Requests to show or close are handled as soon as they arrive; snapshots are
+ * drawn on frame boundaries. Keys are read whenever the connection has data.
+ */
+inline void UiRenderer::run() {
+  Display* display = X11Connection::instance().display(X11Connection::Channel::UI);
+  pollfd fds[2] = { { ConnectionNumber(display), POLLIN, 0 }, { m_wakePipe[0], POLLIN, 0 } };
+
+  bool visible = false;
+  std::shared_ptr<const UiSnapshot> drawn;
+  auto nextFrame = Clock::now();
+  unsigned long rendered = 0;
+  unsigned long skipped = 0;
+  std::vector<uint8_t> columns;
+
+  while (true) {
+    std::optional<ShowRequest> showRequest;
+    bool closeRequest;
+    std::shared_ptr<const UiSnapshot> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_stop) break;
+      showRequest.swap(m_showRequest);
+      closeRequest = m_closeRequest;
+      m_closeRequest = false;
+      snapshot = m_snapshot;
+    }
+
+    if (closeRequest && visible) {
+      m_window.close();
+      visible = false;
+      Logger::instance().log(std::format("UiRenderer: {} frames drawn, {} skipped as unchanged.", rendered, skipped));
+      if (m_spectrogram) Logger::instance().log("UiRenderer: Spectrogram " + m_spectrogram->report());
+      rendered = skipped = 0;
+    }
+    if (showRequest) {
+      m_window.show(showRequest->text, showRequest->takeFocus, showRequest->triggerTime);
+      visible = true;
+      drawn.reset();
+      if (m_spectrogram) m_spectrogram->reset(); // Audio from before the window is stale
+      nextFrame = Clock::now() + m_framePeriod;
+    }
+
+    auto now = Clock::now();
+    if (visible && (snapshot || m_spectrogram) && now >= nextFrame) {
+      if (!snapshot) {
+        // Nothing published yet; only the strip moves
+      } else if (drawn && sameFrame(*drawn, *snapshot)) {
+        ++skipped;
+      } else {
+        m_window.setBackgroundColor(snapshot->background);
+        m_window.updateText(snapshot->text, snapshot->level);
+        drawn = snapshot;
+        ++rendered;
+      }
+      if (m_spectrogram) {
+        columns.clear();
+        size_t count = m_spectrogram->compute(columns, m_spectrumBudget);
+        if (count > 0) m_window.drawSpectrogram(columns.data(), count);
+      }
+      nextFrame += m_framePeriod;
+      if (nextFrame < now) nextFrame = now + m_framePeriod; // Fell behind: don't burst
+    }
+
+    // Empties Xlib's queue too, so poll() below only sleeps when there is nothing to read
+    char key;
+    if (visible && m_window.checkForInput(key)) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_keys.push_back(key);
+    }
+
+    int waitMs = -1;
+    if (visible) {
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(nextFrame - Clock::now());
+      waitMs = std::max<int>(0, (int)left.count());
+    }
+    if (poll(fds, 2, waitMs) < 0 && errno != EINTR) break;
+    if (fds[1].revents & POLLIN) {
+      char drain[16];
+      while (read(m_wakePipe[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+    if (!visible && (fds[0].revents & POLLIN)) {
+      // Nothing mapped: drop stray events so the connection does not stay readable
+      while (XPending(display) > 0) {
+        XEvent e;
+        XNextEvent(display, &e);
+      }
+    }
+  }
+  if (visible) m_window.close();
+}
+
+inline bool UiRenderer::sameFrame(const UiSnapshot& a, const UiSnapshot& b) const {
+  return a.text == b.text && a.background == b.background &&
+         m_window.meterFill(a.level) == m_window.meterFill(b.level);
+}
+
+inline void UiRenderer::show(const std::string& text, bool takeFocus, Clock::time_point triggerTime) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_showRequest = ShowRequest{ text, takeFocus, triggerTime };
+    m_snapshot.reset();
+    m_keys.clear();
+  }
+  wake();
+}
+
+inline void UiRenderer::wake() {
+  char wake = 1;
+  if (write(m_wakePipe[1], &wake, 1) < 0 && errno != EAGAIN) {
+    Logger::instance().error("UiRenderer: Failed to wake the render thread.");
+  }
+}
+
+#endif // VOICECLI_SRC_UIRENDERER_HPP
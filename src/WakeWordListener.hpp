@@ -0,0 +1,381 @@
+#ifndef VOICECLI_SRC_WAKEWORDLISTENER_HPP
+#define VOICECLI_SRC_WAKEWORDLISTENER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "../third_party/miniaudio.h"
+#include "Logger.hpp"
+#include "Recorder.hpp"
+#include "Transcriber.hpp"
+
+/**
+ * @brief Low-CPU keyword spotter used as an alternative session trigger.
+ *
+ * Keeps a capture stream open and feeds it through a lock-free ring buffer. An
+ * energy gate over 20ms frames (adaptive noise floor) finds short utterances;
+ * only those are handed to a small Whisper model and matched against the wake
+ * phrase. While the room is quiet the cost is one peak scan per frame. The floor
+ * also creeps up during long bursts, so steady noise or background talk stops
+ * counting as speech, and candidates cut off at the length cap are checked at
+ * most once per 10 s. The process's CPU share is logged on every trigger and
+ * every 10 minutes of listening.
+ *
+ * The stream stays open across a trigger: the session's Recorder is fed from it
+ * (forwardTo()), so words spoken right after the wake phrase, including those
+ * said while the detector ran, reach the session.
+ */
+class WakeWordListener {
+public:
+  /**
+   * @brief Configures the listener.
+   *
+   * @param pDeviceID Pointer to the miniaudio capture device ID.
+   * @param sampleRate Capture rate; pre-roll is delivered at this rate.
+   * @param wakeWord The phrase to listen for (case and punctuation are ignored).
+   * @param detector A transcriber loaded with a small model, used for candidates only.
+   * @param gateLevel Minimum peak level for a frame to count as speech.
+   */
+  WakeWordListener(ma_device_id* pDeviceID, unsigned int sampleRate, const std::string& wakeWord,
+                   Transcriber& detector, float gateLevel);
+  ~WakeWordListener();
+
+  // Disable copying
+  WakeWordListener(const WakeWordListener&) = delete;
+  WakeWordListener& operator=(const WakeWordListener&) = delete;
+
+  /**
+   * @brief Feeds the stream to a recorder started without its own device, or stops it.
+   *
+   * Audio captured since waitForWake() returned goes to the recorder first.
+   *
+   * @param recorder The session's recorder, or nullptr to stop the stream (waits for
+   *        the callback in progress, so the recorder can be stopped afterwards).
+   */
+  void forwardTo(Recorder* recorder);
+
+  /**
+   * @brief Removes a leading wake phrase from a transcription.
+   *
+   * @param text The transcribed text, which may start with the wake phrase.
+   * @param wakeWord The wake phrase.
+   * @return The text following the wake phrase, or the text unchanged if it does not start with it.
+   */
+  static std::string stripWakeWord(const std::string& text, const std::string& wakeWord);
+
+  /**
+   * @brief Blocks until the wake phrase is heard.
+   *
+   * Starts the stream on entry (opening the device the first time) and leaves
+   * it running on return; hand it to the session with forwardTo().
+   *
+   * @param outPreRoll Receives the audio of the triggering utterance and whatever followed
+   *        it while it was checked (at the capture rate).
+   * @return true when triggered, false if the capture device failed.
+   */
+  bool waitForWake(std::vector<float>& outPreRoll);
+
+private:
+  static void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+  static std::string normalize(const std::string& text);
+  static std::chrono::nanoseconds processCpuTime();
+
+  bool checkCandidate(const std::vector<float>& window);
+
+  ma_device_config m_deviceConfig;
+  ma_device m_device;
+  bool m_deviceReady;                 // m_device is initialized (it stays so until destruction)
+  ma_pcm_rb m_ring;
+  std::atomic<Recorder*> m_forward;   // Receives the stream instead of m_ring while set
+  unsigned int m_sampleRate;
+  std::string m_wakeWord;
+  std::string m_normalizedWakeWord;
+  Transcriber& m_detector;
+  float m_gateLevel;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline WakeWordListener::WakeWordListener(ma_device_id* pDeviceID, unsigned int sampleRate,
+                                          const std::string& wakeWord, Transcriber& detector,
+                                          float gateLevel)
+    : m_deviceReady(false), m_forward(nullptr), m_sampleRate(sampleRate), m_wakeWord(wakeWord),
+      m_normalizedWakeWord(normalize(wakeWord)), m_detector(detector), m_gateLevel(gateLevel) {
+  if (m_normalizedWakeWord.empty()) {
+    throw std::invalid_argument("Wake word must contain letters or digits.");
+  }
+
+  // One second of headroom; the consumer drains every 50ms.
+  if (ma_pcm_rb_init(ma_format_f32, 1, sampleRate, NULL, NULL, &m_ring) != MA_SUCCESS) {
+    throw std::runtime_error("Failed to allocate wake word ring buffer.");
+  }
+
+  m_deviceConfig = ma_device_config_init(ma_device_type_capture);
+  m_deviceConfig.capture.pDeviceID = pDeviceID;
+  m_deviceConfig.capture.format = ma_format_f32;
+  m_deviceConfig.capture.channels = 1;
+  m_deviceConfig.sampleRate = sampleRate;
+  m_deviceConfig.dataCallback = data_callback;
+  m_deviceConfig.pUserData = this;
+}
+
+inline WakeWordListener::~WakeWordListener() {
+  if (m_deviceReady) ma_device_uninit(&m_device);
+  ma_pcm_rb_uninit(&m_ring);
+}
+
+inline bool WakeWordListener::checkCandidate(const std::vector<float>& window) {
+  auto start = std::chrono::steady_clock::now();
+  std::string heard;
+  try {
+    heard = m_detector.transcribeSnippet(Transcriber::resampleTo16k(window, m_sampleRate));
+  } catch (const std::exception& e) {
+    Logger::instance().error(std::format("WakeWord: Detector failed: {}", e.what()));
+    return false;
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+  bool match = normalize(heard).find(m_normalizedWakeWord) != std::string::npos;
+  Logger::instance().log(std::format("WakeWord: {:.2f}s candidate checked in {} ms ({}).",
+                                     window.size() / (double)m_sampleRate, ms.count(),
+                                     match ? "match" : "no match"));
+  return match;
+}
+
+/**
+ * @brief Static callback function for miniaudio device data.
+ *
+ * Only copies the frames into the ring buffer; all analysis happens on the
+ * waiting thread. Frames that do not fit are dropped. Once a session recorder
+ * is set, the ring's backlog and then the live frames go to it instead.
+ */
+inline void WakeWordListener::data_callback(ma_device* pDevice, void* pOutput, const void* pInput,
+                                            ma_uint32 frameCount) {
+  WakeWordListener* pListener = (WakeWordListener*)pDevice->pUserData;
+  const float* src = (const float*)pInput;
+
+  if (Recorder* recorder = pListener->m_forward.load(std::memory_order_acquire)) {
+    // The waiting thread no longer reads the ring, so this thread takes over as its consumer
+    for (int round = 0; round < 2; ++round) {
+      ma_uint32 chunk = ma_pcm_rb_available_read(&pListener->m_ring);
+      void* pSrc;
+      if (chunk == 0 || ma_pcm_rb_acquire_read(&pListener->m_ring, &chunk, &pSrc) != MA_SUCCESS) break;
+      recorder->feed((const float*)pSrc, chunk);
+      ma_pcm_rb_commit_read(&pListener->m_ring, chunk);
+    }
+    recorder->feed(src, frameCount);
+    return;
+  }
+
+  // The ring may wrap, so at most two acquire/commit rounds are needed.
+  for (int round = 0; round < 2 && frameCount > 0; ++round) {
+    ma_uint32 chunk = frameCount;
+    void* pDst;
+    if (ma_pcm_rb_acquire_write(&pListener->m_ring, &chunk, &pDst) != MA_SUCCESS || chunk == 0) break;
+    std::copy(src, src + chunk, (float*)pDst);
+    ma_pcm_rb_commit_write(&pListener->m_ring, chunk);
+    src += chunk;
+    frameCount -= chunk;
+  }
+  (void)pOutput; // Unused
+}
+
+inline void WakeWordListener::forwardTo(Recorder* recorder) {
+  if (!m_deviceReady) return;
+  if (!recorder) {
+    ma_device_stop(&m_device); // Returns once no callback is running
+    m_forward.store(nullptr, std::memory_order_release);
+    return;
+  }
+  if (!ma_device_is_started(&m_device)) {
+    ma_pcm_rb_reset(&m_ring); // A restarted stream has no backlog worth keeping
+    m_forward.store(recorder, std::memory_order_release);
+    if (ma_device_start(&m_device) != MA_SUCCESS) {
+      Logger::instance().error("WakeWord: Failed to restart capture device.");
+    }
+    return;
+  }
+  m_forward.store(recorder, std::memory_order_release);
+}
+
+inline std::string WakeWordListener::normalize(const std::string& text) {
+  std::string out;
+  for (unsigned char c : text) {
+    if (std::isalnum(c)) out += (char)std::tolower(c);
+  }
+  return out;
+}
+
+/**
+ * @brief CPU time of the whole process, which includes the detector's inference threads.
+ */
+inline std::chrono::nanoseconds WakeWordListener::processCpuTime() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+inline std::string WakeWordListener::stripWakeWord(const std::string& text, const std::string& wakeWord) {
+  std::string target = normalize(wakeWord);
+  size_t matched = 0;
+  size_t i = 0;
+
+  // Walk the text, matching the wake phrase while skipping spaces and punctuation.
+  for (; i < text.size() && matched < target.size(); ++i) {
+    unsigned char c = text[i];
+    if (!std::isalnum(c)) continue;
+    if ((char)std::tolower(c) != target[matched]) return text;
+    ++matched;
+  }
+  if (matched < target.size()) return text;
+
+  while (i < text.size() && (std::ispunct((unsigned char)text[i]) || std::isspace((unsigned char)text[i]))) {
+    ++i;
+  }
+  return text.substr(i);
+}
+
+inline bool WakeWordListener::waitForWake(std::vector<float>& outPreRoll) {
+  if (!m_deviceReady) {
+    if (ma_device_init(NULL, &m_deviceConfig, &m_device) != MA_SUCCESS) {
+      Logger::instance().error("WakeWord: Failed to initialize capture device.");
+      return false;
+    }
+    m_deviceReady = true;
+  }
+  forwardTo(nullptr); // Stops the stream if a session left it running
+  ma_pcm_rb_reset(&m_ring);
+  if (ma_device_start(&m_device) != MA_SUCCESS) {
+    Logger::instance().error("WakeWord: Failed to start capture device.");
+    return false;
+  }
+  Logger::instance().log("WakeWord: Listening for \"" + m_wakeWord + "\".");
+
+  const size_t frameLen = m_sampleRate / 50;      // 20ms analysis frames
+  const size_t leadFrames = 10;                   // 200ms kept before speech onset
+  const size_t hangFrames = 15;                   // 300ms of silence ends an utterance
+  const size_t minFrames = 12;                    // Shorter bursts are clicks, not words
+  const size_t maxFrames = 150;                   // 3s cap on a candidate
+  const size_t historyCap = (leadFrames + maxFrames) * frameLen;
+  const auto cappedInterval = std::chrono::seconds(10); // Between checks of capped bursts
+  const auto reportInterval = std::chrono::minutes(10);
+
+  std::vector<float> history;    // Recent audio, trimmed to historyCap
+  std::vector<float> pending;    // Samples not yet analysed as a full frame
+  float noiseFloor = 0.001f;
+  bool inSpeech = false;
+  size_t speechFrames = 0;
+  size_t silentFrames = 0;
+  size_t onsetOffset = 0;        // Index into history where the candidate starts
+  bool triggered = false;
+
+  auto listenStart = std::chrono::steady_clock::now();
+  auto cpuStart = processCpuTime();
+  auto nextReport = listenStart + reportInterval;
+  auto nextCapped = listenStart;
+  size_t candidates = 0;
+  auto report = [&](const char* what) {
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - listenStart).count();
+    double cpuSec = std::chrono::duration<double>(processCpuTime() - cpuStart).count();
+    Logger::instance().log(std::format("WakeWord: {} after {:.1f}s listening, {} candidate(s) checked, "
+                                       "CPU {:.3f}% of one core.",
+                                       what, wallSec, candidates, wallSec > 0 ? 100.0 * cpuSec / wallSec : 0.0));
+  };
+
+  while (!triggered) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Drain the ring buffer
+    for (int round = 0; round < 2; ++round) {
+      ma_uint32 chunk = ma_pcm_rb_available_read(&m_ring);
+      void* pSrc;
+      if (chunk == 0 || ma_pcm_rb_acquire_read(&m_ring, &chunk, &pSrc) != MA_SUCCESS) break;
+      const float* samples = (const float*)pSrc;
+      pending.insert(pending.end(), samples, samples + chunk);
+      ma_pcm_rb_commit_read(&m_ring, chunk);
+    }
+
+    size_t consumed = 0;
+    for (; consumed + frameLen <= pending.size() && !triggered; consumed += frameLen) {
+      const float* frame = pending.data() + consumed;
+      float peak = 0.0f;
+      for (size_t i = 0; i < frameLen; ++i) peak = std::max(peak, std::abs(frame[i]));
+
+      history.insert(history.end(), frame, frame + frameLen);
+      bool loud = peak > std::max(m_gateLevel, noiseFloor * 4.0f);
+
+      if (!inSpeech) {
+        noiseFloor = 0.95f * noiseFloor + 0.05f * peak;
+        if (loud) {
+          inSpeech = true;
+          speechFrames = 1;
+          silentFrames = 0;
+          size_t lead = std::min(history.size(), (leadFrames + 1) * frameLen);
+          onsetOffset = history.size() - lead;
+        }
+      } else {
+        // Slowly (about 10s) in speech: words barely move it, steady noise raises it above the gate
+        noiseFloor = 0.998f * noiseFloor + 0.002f * peak;
+        speechFrames++;
+        silentFrames = loud ? 0 : silentFrames + 1;
+
+        if (silentFrames >= hangFrames || speechFrames >= maxFrames) {
+          inSpeech = false;
+          bool capped = silentFrames < hangFrames;
+          auto now = std::chrono::steady_clock::now();
+          if (speechFrames - silentFrames >= minFrames && (!capped || now >= nextCapped)) {
+            ++candidates;
+            std::vector<float> window(history.begin() + onsetOffset, history.end());
+            if (checkCandidate(window)) {
+              outPreRoll = std::move(window);
+              triggered = true;
+            } else if (capped) {
+              nextCapped = std::chrono::steady_clock::now() + cappedInterval;
+            }
+          }
+        }
+      }
+
+      // Keep the history bounded without shifting on every frame
+      if (!inSpeech && history.size() > 2 * historyCap) {
+        history.erase(history.begin(), history.end() - historyCap);
+      }
+    }
+
+    if (triggered) {
+      // What followed the phrase, including what was said while the detector ran, belongs to the session
+      outPreRoll.insert(outPreRoll.end(), pending.begin() + consumed, pending.end());
+      for (int round = 0; round < 2; ++round) {
+        ma_uint32 chunk = ma_pcm_rb_available_read(&m_ring);
+        void* pSrc;
+        if (chunk == 0 || ma_pcm_rb_acquire_read(&m_ring, &chunk, &pSrc) != MA_SUCCESS) break;
+        const float* samples = (const float*)pSrc;
+        outPreRoll.insert(outPreRoll.end(), samples, samples + chunk);
+        ma_pcm_rb_commit_read(&m_ring, chunk);
+      }
+    } else {
+      pending.erase(pending.begin(), pending.begin() + consumed);
+      if (std::chrono::steady_clock::now() >= nextReport) {
+        report("Still listening");
+        nextReport += reportInterval;
+      }
+    }
+  }
+
+  report("Triggered");
+  return true;
+}
+
+#endif // VOICECLI_SRC_WAKEWORDLISTENER_HPP
@@ -0,0 +1,113 @@
+#ifndef VOICECLI_SRC_WORKSTEALINGQUEUE_HPP
+#define VOICECLI_SRC_WORKSTEALINGQUEUE_HPP
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief A set of per-worker deques with stealing.
+ *
+ * Each worker pops from the front of its own lane. When its lane is empty it
+ * steals from the back of the other lanes, so a worker stuck on a long item
+ * does not hold back the rest of its share. Items are expected to be coarse
+ * (whole files), so each lane is guarded by its own small mutex.
+ */
+template <typename T>
+class WorkStealingQueue {
+public:
+  /**
+   * @brief Creates one lane per worker.
+   * @param workers Number of workers (at least 1).
+   */
+  explicit WorkStealingQueue(size_t workers);
+
+  // Disable copying
+  WorkStealingQueue(const WorkStealingQueue&) = delete;
+  WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+  /**
+   * @brief Takes the next item for a worker, stealing if its own lane is empty.
+   * @param worker Index of the calling worker.
+   * @param out Receives the item.
+   * @return false once every lane is empty.
+   */
+  bool pop(size_t worker, T& out);
+
+  /**
+   * @brief Appends an item to a worker's lane.
+   * @param worker Index of the lane (taken modulo the number of lanes).
+   * @param item The item to queue.
+   */
+  void push(size_t worker, T item);
+
+  /**
+   * @brief Returns the number of lanes.
+   */
+  size_t size() const;
+
+private:
+  struct Lane {
+    std::mutex mutex;
+    std::deque<T> items;
+  };
+
+  std::vector<std::unique_ptr<Lane>> m_lanes;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+template <typename T>
+inline WorkStealingQueue<T>::WorkStealingQueue(size_t workers) {
+  if (workers == 0) workers = 1;
+  m_lanes.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    m_lanes.push_back(std::make_unique<Lane>());
+  }
+}
+
+template <typename T>
+inline bool WorkStealingQueue<T>::pop(size_t worker, T& out) {
+  const size_t count = m_lanes.size();
+  worker %= count;
+
+  {
+    Lane& own = *m_lanes[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.items.empty()) {
+      out = std::move(own.items.front());
+      own.items.pop_front();
+      return true;
+    }
+  }
+
+  // Own lane is dry: steal from the opposite end of the next non-empty lane.
+  for (size_t i = 1; i < count; ++i) {
+    Lane& victim = *m_lanes[(worker + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.items.empty()) {
+      out = std::move(victim.items.back());
+      victim.items.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+inline void WorkStealingQueue<T>::push(size_t worker, T item) {
+  Lane& lane = *m_lanes[worker % m_lanes.size()];
+  std::lock_guard<std::mutex> lock(lane.mutex);
+  lane.items.push_back(std::move(item));
+}
+
+template <typename T>
+inline size_t WorkStealingQueue<T>::size() const {
+  return m_lanes.size();
+}
+
+#endif // VOICECLI_SRC_WORKSTEALINGQUEUE_HPP
@@ -0,0 +1,155 @@
+#ifndef VOICECLI_SRC_X11CONNECTION_HPP
+#define VOICECLI_SRC_X11CONNECTION_HPP
+
+#include <X11/Xlib.h>
+#include <array>
+#include <format>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Owns the daemon's X server connections and an interned-atom cache.
+ *
+ * Connections are opened on first use and kept until exit, so no session pays
+ * for XOpenDisplay. Each component gets its own channel (connection), because
+ * each runs its own event loop: a single shared queue would let the status
+ * window swallow the input hook's raw key events or the paster's selection
+ * requests.
+ *
+ * Atoms are server-global, so one cache serves all channels. The common ones
+ * are interned in a single XInternAtoms round trip when the first channel opens.
+ */
+class X11Connection {
+public:
+  enum class Channel { Input, UI, Paste, Count };
+
+  /**
+   * @brief Access the singleton instance.
+   */
+  static X11Connection& instance();
+
+  /**
+   * @brief Returns the interned atom for a name, interning it on first use.
+   * @param name The atom name (e.g. "CLIPBOARD").
+   */
+  Atom atom(const std::string& name);
+
+  /**
+   * @brief Closes all open connections. Called at exit; later use reopens them.
+   */
+  void closeAll();
+
+  /**
+   * @brief Returns the connection for a channel, opening it on first use.
+   * @throws std::runtime_error If the X display cannot be opened.
+   */
+  Display* display(Channel channel);
+
+  /**
+   * @brief Returns the window that currently holds the keyboard focus (0 if unknown).
+   */
+  Window focusedWindow();
+
+private:
+  X11Connection();
+  ~X11Connection();
+
+  // Disable copying
+  X11Connection(const X11Connection&) = delete;
+  X11Connection& operator=(const X11Connection&) = delete;
+
+  static int errorHandler(Display* display, XErrorEvent* error);
+
+  std::array<Display*, (size_t)Channel::Count> m_displays;
+  std::unordered_map<std::string, Atom> m_atoms;
+  std::mutex m_mutex;
+};
+
+// -----------------------------------------------------------------------------
+// Inline Implementations
+// -----------------------------------------------------------------------------
+
+inline X11Connection::X11Connection() {
+  m_displays.fill(nullptr);
+}
+
+inline X11Connection::~X11Connection() {
+  closeAll();
+}
+
+inline X11Connection& X11Connection::instance() {
+  static X11Connection s_instance;
+  return s_instance;
+}
+
+inline Atom X11Connection::atom(const std::string& name) {
+  Display* d = display(Channel::UI);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_atoms.find(name);
+  if (it != m_atoms.end()) return it->second;
+
+  Atom a = XInternAtom(d, name.c_str(), False);
+  m_atoms.emplace(name, a);
+  return a;
+}
+
+inline void X11Connection::closeAll() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& d : m_displays) {
+    if (d) XCloseDisplay(d);
+    d = nullptr;
+  }
+}
+
+inline Display* X11Connection::display(Channel channel) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Display*& d = m_displays[(size_t)channel];
+  if (d) return d;
+
+  // Components run on their own threads; Xlib needs to know before the first connection
+  static bool s_threadsInitialized = XInitThreads() != 0;
+  (void)s_threadsInitialized;
+
+  d = XOpenDisplay(NULL);
+  if (!d) {
+    throw std::runtime_error("Failed to open X Display.");
+  }
+
+  if (m_atoms.empty()) {
+    // A stale window id must not take the daemon down with it
+    XSetErrorHandler(errorHandler);
+
+    const char* names[] = { "CLIPBOARD", "UTF8_STRING", "TARGETS", "_NET_WM_STATE",
+                            "_NET_WM_STATE_ABOVE", "_NET_ACTIVE_WINDOW" };
+    constexpr int count = sizeof(names) / sizeof(names[0]);
+    Atom atoms[count];
+    if (XInternAtoms(d, (char**)names, count, False, atoms)) {
+      for (int i = 0; i < count; ++i) m_atoms.emplace(names[i], atoms[i]);
+    }
+  }
+  return d;
+}
+
+inline int X11Connection::errorHandler(Display* display, XErrorEvent* error) {
+  char text[128];
+  XGetErrorText(display, error->error_code, text, sizeof(text));
+  Logger::instance().error(std::format("X11: {} (request {}, resource 0x{:x})", text,
+                                       (int)error->request_code, error->resourceid));
+  return 0;
+}
+
+inline Window X11Connection::focusedWindow() {
+  // Not the paste channel: the paster's clipboard thread may own it
+  Display* d = display(Channel::Input);
+  Window focus = 0;
+  int revert;
+  XGetInputFocus(d, &focus, &revert);
+  return focus;
+}
+
+#endif // VOICECLI_SRC_X11CONNECTION_HPP